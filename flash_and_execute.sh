@@ -18,7 +18,9 @@ help()
 {
     echo "Usage: ./flash_and_execute [ -m | --mram_img mram_img_file ]
                            [ -f | --flash_img flash_img_file ]
-                           [ -e | --exec elf_file -a | --addr 0x1c0XXXXX ]
+                           [ --mram_offset 0xXXXX ] [ --flash_offset 0xXXXX ]
+                           [ -e | --exec elf_file [ -a | --addr 0x1c0XXXXX ] [ --rtt ] ]
+                           [ --boot mram|flash|0xXX [ -e elf_file --rtt ] ]
                            [ -h | --help  ]"
     exit 2
 }
@@ -34,7 +36,7 @@ function getopts-extra () {
 
 
 # option --output/-o requires 1 argument
-LONGOPTS=mram_img:,flash_img:,exec:,addr:,help
+LONGOPTS=mram_img:,flash_img:,mram_offset:,flash_offset:,exec:,addr:,rtt,boot:,help
 OPTIONS=m:,f:,e:,a:,h
 
 # -temporarily store output to be able to check for errors
@@ -53,7 +55,7 @@ fi
 eval set -- "$PARSED"
 
 
-m=n f=n e=n addr=n
+m=n f=n e=n addr=n rtt=n boot=n mram_offset=0x0 flash_offset=0x0
 # now enjoy the options in order and nicely split until we see --
 while true; do
     case "$1" in
@@ -65,6 +67,14 @@ while true; do
             f=$2
             shift 2
             ;;
+        --mram_offset)
+            mram_offset=$2
+            shift 2
+            ;;
+        --flash_offset)
+            flash_offset=$2
+            shift 2
+            ;;
         -e|--exec)
             e=$2
             shift 2
@@ -73,6 +83,14 @@ while true; do
             addr=$2
             shift 2
             ;;
+        --rtt)
+            rtt=y
+            shift
+            ;;
+        --boot)
+            boot=$2
+            shift 2
+            ;;
         -h | --help)
             help
             ;;
@@ -96,34 +114,156 @@ done
 #echo "exec:  $e $addr, flash_img: $f, mram_img: $m"
 
 
+# JTAG clock measured for this adapter by openocd_tools/host/gap9-jtag-tune --bench
+adapter_khz=$($path/openocd_tools/host/gap9-jtag-tune 2>/dev/null) || adapter_khz=5000
+
+# Entry point, bridge addresses and build hash of the flashers are read from
+# their ELF (cached by openocd_tools/host/gap9-elf-info), the defaults are kept
+# when it cannot run.
+elf_info=$path/openocd_tools/host/gap9-elf-info
+flasher_info()
+{
+  local hash addrs
+  hash=$($elf_info --flasher-id $1 2>/dev/null) || hash=""
+  addrs=$($elf_info --entry --symbol __rt_debug_struct_ptr --symbol debug_struct $1 2>/dev/null) || addrs="0x1c010080 0x1c010090 0"
+  echo "\"$hash\" {$addrs}"
+}
+
+# Prefer the minimal flashers when they are built, they load faster over JTAG.
+# Their runtime differs from the regular flashers, so the default addresses do
+# not apply: they are only used when all of them can be read from the ELF.
+flasher_min()
+{
+  [ -f $1 ] && $elf_info --entry --symbol __rt_debug_struct_ptr --symbol debug_struct --flasher-id $1 >/dev/null 2>&1
+}
+mram_flasher=$path/openocd_tools/gap_bins/gap_flasher-gap9_evk-mram.elf
+flash_flasher=$path/openocd_tools/gap_bins/gap_flasher-gap9_evk.elf
+if flasher_min $path/openocd_tools/gap_bins/gap_flasher-gap9_evk-mram-min.elf
+then
+  mram_flasher=$path/openocd_tools/gap_bins/gap_flasher-gap9_evk-mram-min.elf
+fi
+if flasher_min $path/openocd_tools/gap_bins/gap_flasher-gap9_evk-min.elf
+then
+  flash_flasher=$path/openocd_tools/gap_bins/gap_flasher-gap9_evk-min.elf
+fi
+
+## Flash INTO MRAM and OCTOSPI Flash concurrently, with the dual flasher
+dual_flasher=$path/openocd_tools/gap_bins/gap_flasher-gap9_evk-dual.elf
+dual=n
+if [[ "$m" != "n" ]] && [ -f $m ] && [[ "$f" != "n" ]] && [ -f $f ] && [ -f $dual_flasher ]
+then
+  dual=y
+  MRAM_FILESIZE=$(stat -c%s "$m")
+  FLASH_FILESIZE=$(stat -c%s "$f")
+  printf "\n\nFlashing into MRAM $m of size $MRAM_FILESIZE at Address $mram_offset and OCTOSPI Flash $f of size $FLASH_FILESIZE at Address $flash_offset\n\n"
+
+  ./openocd_ubuntu2204/bin/openocd -c "gdb_port disabled; telnet_port disabled; tcl_port disabled; set GAP_ADAPTER_KHZ $adapter_khz" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" -f "$path/openocd_tools/tcl/flash_image.tcl" -c "gap9_flash_raw_dual ${m} $MRAM_FILESIZE ${f} $FLASH_FILESIZE $dual_flasher $mram_offset $flash_offset $(flasher_info $dual_flasher); exit;"
+
+fi
+
 ## Flash INTO MRAM
-if [[ "$m" != "n" ]] && [ -f $m ]
+if [[ "$dual" != "y" ]] && [[ "$m" != "n" ]] && [ -f $m ]
 then
   FILESIZE=$(stat -c%s "$m")
   # The content of $m is different from "n" and is a file, then get the size and flash it
-  printf "\n\nFlashing into MRAM $m of size $FILESIZE at defulat Address 0x2000\n\n"
+  printf "\n\nFlashing into MRAM $m of size $FILESIZE at Address $mram_offset\n\n"
 
-  ./openocd_ubuntu2204/bin/openocd -c "gdb_port disabled; telnet_port disabled; tcl_port disabled" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" -f "$path/openocd_tools/tcl/flash_image.tcl" -c "gap9_flash_raw ${m} $FILESIZE $path/openocd_tools/gap_bins/gap_flasher-gap9_evk-mram.elf 0x2000; exit;"
+  ./openocd_ubuntu2204/bin/openocd -c "gdb_port disabled; telnet_port disabled; tcl_port disabled; set GAP_ADAPTER_KHZ $adapter_khz" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" -f "$path/openocd_tools/tcl/flash_image.tcl" -c "gap9_flash_raw ${m} $FILESIZE $mram_flasher 0x40000 $mram_offset $(flasher_info $mram_flasher); exit;"
 
 fi
 
 ## Flash INTO OCTOSPI FLash
-if [[ "$f" != "n" ]] && [ -f $f ]
+if [[ "$dual" != "y" ]] && [[ "$f" != "n" ]] && [ -f $f ]
 then
   FILESIZE=$(stat -c%s "$f")
   # The content of $f is different from "n" and is a file, then get the size and flash it
-  printf "\n\nFlashing into OCTOSPI Flash $f of size $FILESIZE at defulat Address 0x2000\n\n"
+  printf "\n\nFlashing into OCTOSPI Flash $f of size $FILESIZE at Address $flash_offset\n\n"
 
-  ./openocd_ubuntu2204/bin/openocd -c "gdb_port disabled; telnet_port disabled; tcl_port disabled" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" -f "$path/openocd_tools/tcl/flash_image.tcl" -c "gap9_flash_raw ${f} $FILESIZE $path/openocd_tools/gap_bins/gap_flasher-gap9_evk.elf 0x2000; exit;"
+  ./openocd_ubuntu2204/bin/openocd -c "gdb_port disabled; telnet_port disabled; tcl_port disabled; set GAP_ADAPTER_KHZ $adapter_khz" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" -f "$path/openocd_tools/tcl/flash_image.tcl" -c "gap9_flash_raw ${f} $FILESIZE $flash_flasher 0x2000 $flash_offset $(flasher_info $flash_flasher); exit;"
 
 fi
 
+## Boot the flashed image, without the BOOT1 jumper nor the reset button
+if [[ "$boot" != "n" ]]
+then
+  printf "\n\nBooting from $boot\n\n"
+
+  # confreg of the flash boot, which depends on the board
+  boot_set=""
+  if [[ -n "${GAP_BOOT_FLASH_CONFREG:-}" ]]
+  then
+    boot_set="; set GAP_BOOT_FLASH_CONFREG $GAP_BOOT_FLASH_CONFREG"
+  fi
+
+  # with --exec elf_file --rtt, the ELF of the flashed image is not loaded but
+  # its log channel is streamed once booted
+  tcl_port=disabled
+  rtt_tcl=()
+  if [[ "$rtt" == "y" ]] && [[ "$e" != "n" ]] && [ -f $e ]
+  then
+    tcl_port=6666
+    rtt_tcl=(-f "$path/openocd_tools/tcl/rtt.tcl")
+    boot_cmd="gap9_boot_image $boot"
+  else
+    boot_cmd="gap9_boot_image $boot; exit"
+  fi
+  # this config neither resets the board nor halts the FC at init
+  openocd_boot=(./openocd_ubuntu2204/bin/openocd -d0 -c "gdb_port disabled; telnet_port disabled; tcl_port $tcl_port; set GAP_ADAPTER_KHZ $adapter_khz$boot_set" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb_boot_profile.tcl" ${rtt_tcl[@]+"${rtt_tcl[@]}"} -c "$boot_cmd")
+
+  if [[ "$tcl_port" != "disabled" ]]
+  then
+    "${openocd_boot[@]}" &
+    openocd_pid=$!
+    trap "kill $openocd_pid 2>/dev/null" EXIT
+    $path/openocd_tools/host/gap9-rtt $e
+  else
+    "${openocd_boot[@]}"
+  fi
+
+  # the image runs from MRAM or flash, the ELF is not executed from JTAG
+  e=n
+fi
+
 ## Execute app from JTAG
+if [[ "$e" != "n" ]] && [ -f $e ] && [[ "$addr" == "n" ]]
+then
+  # no --addr, read _start from the ELF
+  addr=$($elf_info --entry $e)
+fi
 if [[ "$e" != "n" ]] && [ -f $e ] && [[ "$addr" != "n" ]]
 then
   # The content of $f is different from "n" and is a file, then get the size and flash it
   printf "\n\nExecuting ELF $e with START address at $addr\n\n"
 
-  ./openocd_ubuntu2204/bin/openocd -d0 -c "gdb_port disabled; telnet_port disabled; tcl_port disabled" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" -c "load_and_start_binary  $e $addr"
+  # with --rtt, openocd stays attached with its Tcl RPC port open and the log
+  # channel of the application (openocd_tools/src/rtt) is streamed to stdout
+  tcl_port=disabled
+  rtt_tcl=()
+  if [[ "$rtt" == "y" ]]
+  then
+    tcl_port=6666
+    rtt_tcl=(-f "$path/openocd_tools/tcl/rtt.tcl")
+  fi
+
+  # only the blocks of the ELF which are not already in memory are loaded
+  if plan=$($elf_info --load-plan 1024 $e 2>/dev/null)
+  then
+    exec_cmd="gap9_load_incremental $e $addr {$plan}"
+    exec_tcl=(-f "$path/openocd_tools/tcl/load_incremental.tcl")
+  else
+    exec_cmd="load_and_start_binary  $e $addr"
+    exec_tcl=()
+  fi
+  openocd_exec=(./openocd_ubuntu2204/bin/openocd -d0 -c "gdb_port disabled; telnet_port disabled; tcl_port $tcl_port; set GAP_ADAPTER_KHZ $adapter_khz" -f "$path/openocd_tools/tcl/gapuino_ftdi.cfg" -f "$path/openocd_tools/tcl/gap9revb.tcl" ${exec_tcl[@]+"${exec_tcl[@]}"} ${rtt_tcl[@]+"${rtt_tcl[@]}"} -c "$exec_cmd")
+
+  if [[ "$rtt" == "y" ]]
+  then
+    "${openocd_exec[@]}" &
+    openocd_pid=$!
+    trap "kill $openocd_pid 2>/dev/null" EXIT
+    $path/openocd_tools/host/gap9-rtt $e
+  else
+    "${openocd_exec[@]}"
+  fi
 
 fi
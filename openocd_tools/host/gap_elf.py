@@ -0,0 +1,356 @@
+#
+# Copyright (C) 2024 GreenWaves Technologies
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Minimal ELF32 little endian reader, enough for the GAP9 host tools without
+# depending on pyelftools or on the RISC-V toolchain.
+
+import bisect
+import hashlib
+import json
+import os
+import struct
+
+ET_CORE = 4
+
+EM_RISCV = 243
+
+PT_LOAD = 1
+PT_NOTE = 4
+
+NT_PRSTATUS = 1
+
+SHT_PROGBITS = 1
+SHT_SYMTAB = 2
+
+SHF_WRITE = 0x1
+
+STT_OBJECT = 1
+STT_FUNC = 2
+
+PF_X = 0x1
+PF_W = 0x2
+PF_R = 0x4
+
+
+# Incremental load: hashes of memory blocks, computed the same way on the target
+# by src/loader/block_hash.S
+BLOCK_HASH_MAX_BLOCKS = 1024
+
+
+def block_hash(data):
+    """FNV-1a on the 32 bits words of data (size multiple of 4)"""
+    h = 0x811c9dc5
+    for (w,) in struct.iter_unpack('<I', data):
+        h = ((h ^ w) * 0x01000193) & 0xffffffff
+    return h
+
+
+class Segment(object):
+
+    def __init__(self, elf, p_type, offset, vaddr, paddr, filesz, memsz, flags):
+        self.elf = elf
+        self.type = p_type
+        self.offset = offset
+        self.vaddr = vaddr
+        # openocd load_image loads segments at their physical (load) address
+        self.paddr = paddr
+        self.filesz = filesz
+        self.memsz = memsz
+        self.flags = flags
+
+    def data(self):
+        return self.elf.data[self.offset:self.offset + self.filesz]
+
+
+class Section(object):
+
+    def __init__(self, elf, name, sh_type, flags, addr, offset, size, link, entsize):
+        self.elf = elf
+        self.name = name
+        self.type = sh_type
+        self.flags = flags
+        self.addr = addr
+        self.offset = offset
+        self.size = size
+        self.link = link
+        self.entsize = entsize
+
+    def data(self):
+        return self.elf.data[self.offset:self.offset + self.size]
+
+
+class Elf(object):
+
+    def __init__(self, path, data=None):
+        self.path = path
+        if data is None:
+            with open(path, 'rb') as f:
+                data = f.read()
+        self.data = data
+
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError('%s: not a 32 bits little endian ELF file' % path)
+
+        (self.type, self.machine, _, self.entry, phoff, shoff, self.flags,
+            _, phentsize, phnum, shentsize, shnum, shstrndx) = \
+            struct.unpack_from('<HHIIIIIHHHHHH', self.data, 16)
+
+        self.segments = []
+        for i in range(phnum):
+            p = struct.unpack_from('<8I', self.data, phoff + i * phentsize)
+            self.segments.append(Segment(self, p[0], p[1], p[2], p[3], p[4], p[5], p[6]))
+
+        self.sections = []
+        headers = [struct.unpack_from('<10I', self.data, shoff + i * shentsize) for i in range(shnum)]
+        for h in headers:
+            self.sections.append(Section(self, h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[9]))
+        if shstrndx < len(self.sections):
+            strtab = self.sections[shstrndx].data()
+            for sec in self.sections:
+                sec.name = self._string(strtab, sec.name)
+
+        self._symbols = None
+        self._functions = None
+        self._objects = None
+
+    @property
+    def load_segments(self):
+        return [s for s in self.segments if s.type == PT_LOAD]
+
+    def load_size(self):
+        """Number of bytes actually pushed by openocd load_image ... elf"""
+        return sum(s.filesz for s in self.load_segments)
+
+    @staticmethod
+    def _string(strtab, offset):
+        return strtab[offset:strtab.index(b'\0', offset)].decode('ascii', 'replace')
+
+    @property
+    def symbols(self):
+        """Dictionary of the named symbols, name -> (value, size)"""
+        if self._symbols is None:
+            self._symbols = {}
+            for sec in self.sections:
+                if sec.type != SHT_SYMTAB:
+                    continue
+                strtab = self.sections[sec.link].data()
+                data = sec.data()
+                for off in range(0, len(data), sec.entsize):
+                    name, value, size, _, _, _ = struct.unpack_from('<IIIBBH', data, off)
+                    if name:
+                        self._symbols[self._string(strtab, name)] = (value, size)
+        return self._symbols
+
+    def _typed_symbols(self, st_type):
+        symbols = set()
+        for sec in self.sections:
+            if sec.type != SHT_SYMTAB:
+                continue
+            strtab = self.sections[sec.link].data()
+            data = sec.data()
+            for off in range(0, len(data), sec.entsize):
+                name, value, size, st_info, _, _ = struct.unpack_from('<IIIBBH', data, off)
+                if name and (st_info & 0xf) == st_type:
+                    symbols.add((value, size, self._string(strtab, name)))
+        return sorted(symbols)
+
+    @property
+    def functions(self):
+        """Function symbols sorted by address, as (addr, size, name)"""
+        if self._functions is None:
+            self._functions = self._typed_symbols(STT_FUNC)
+        return self._functions
+
+    @property
+    def objects(self):
+        """Data symbols sorted by address, as (addr, size, name)"""
+        if self._objects is None:
+            self._objects = self._typed_symbols(STT_OBJECT)
+        return self._objects
+
+    def function_at(self, addr):
+        """Name of the function containing addr, None if unknown. Assembly
+        functions have no size, they are assumed to end at the next one."""
+        functions = self.functions
+        i = bisect.bisect_right(functions, (addr, 0xffffffff, '\uffff')) - 1
+        # several symbols may start at the same address (aliases)
+        start = functions[i][0] if i >= 0 else None
+        while i >= 0 and functions[i][0] == start:
+            size = functions[i][1]
+            if size == 0 or addr < start + size:
+                return functions[i][2]
+            i -= 1
+        return None
+
+    def symbol_at(self, addr):
+        """name+offset of the data or function symbol containing addr, None if
+        unknown"""
+        objects = self.objects
+        i = bisect.bisect_right(objects, (addr, 0xffffffff, '\uffff')) - 1
+        start = objects[i][0] if i >= 0 else None
+        name = None
+        while i >= 0 and objects[i][0] == start:
+            if addr < start + objects[i][1]:
+                name = objects[i][2]
+                break
+            i -= 1
+        if name is None:
+            name = self.function_at(addr)
+            if name is None:
+                return None
+            start = self.symbols[name][0]
+        return name if addr == start else '%s+0x%x' % (name, addr - start)
+
+    def load_plan(self, block_size=1024):
+        """How to load the file incrementally (see tcl/load_incremental.tcl):
+        runs of blocks to hash on the target, as (addr, nb_blocks, block_size,
+        hashes), ranges (addr, size) to always load and ranges to zero (.bss).
+        The ranges to zero are applied first, and never overlap the content of
+        another segment: a .bss only segment may share its load address with
+        the next segment (L1 variables), it is zeroed by the runtime instead."""
+        runs, loads, fills = [], [], []
+        files = [(s.paddr, s.paddr + s.filesz) for s in self.load_segments if s.filesz]
+        for s in self.load_segments:
+            data = s.data()
+            if s.paddr & 3:
+                loads.append((s.paddr, s.filesz))
+            else:
+                words = s.filesz & ~3
+                addr = s.paddr
+                while addr < s.paddr + words:
+                    off = addr - s.paddr
+                    nb = min((words - off) // block_size, BLOCK_HASH_MAX_BLOCKS)
+                    if nb == 0:
+                        # tail of the segment, hashed as a single smaller block
+                        size = words - off
+                        runs.append((addr, 1, size, [block_hash(data[off:off + size])]))
+                        addr += size
+                        continue
+                    hashes = [block_hash(data[off + i * block_size:off + (i + 1) * block_size]) for i in range(nb)]
+                    runs.append((addr, nb, block_size, hashes))
+                    addr += nb * block_size
+                if words != s.filesz:
+                    loads.append((s.paddr + words, s.filesz - words))
+            if s.filesz == 0 and s.vaddr != s.paddr:
+                continue
+            bss = (s.paddr + s.filesz + 3) & ~3
+            bss_end = (s.paddr + s.memsz) & ~3
+            if bss_end > bss and not any(start < bss_end and bss < end for start, end in files):
+                fills.append((bss, bss_end - bss))
+        return runs, loads, fills
+
+    def load_plan_tcl(self, block_size=1024):
+        runs, loads, fills = self.load_plan(block_size)
+        return '{%s} {%s} {%s}' % (
+            ' '.join('{0x%08x %d %d {%s}}' % (a, n, b, ' '.join('0x%08x' % h for h in hs)) for a, n, b, hs in runs),
+            ' '.join('{0x%08x %d}' % r for r in loads),
+            ' '.join('{0x%08x %d}' % r for r in fills))
+
+    def read(self, addr, size):
+        """Initial content of the target memory at addr, as loaded from this file"""
+        for s in self.load_segments:
+            if s.vaddr <= addr and addr + size <= s.vaddr + s.filesz:
+                return s.data()[addr - s.vaddr:addr - s.vaddr + size]
+        raise ValueError('%s: 0x%x is not initialized by the file' % (self.path, addr))
+
+    def read_symbol(self, name):
+        value, size = self.symbols[name]
+        return self.read(value, size)
+
+
+# Parsed information is cached by file content, the same flasher or application
+# ELF is usually resolved many times between two builds.
+CACHE_DIR = os.path.join(os.environ.get('XDG_CACHE_HOME', os.path.expanduser('~/.cache')),
+                         'gap-openocd-tools', 'elf')
+
+
+def info(path, use_cache=True):
+    """Entry point, load size and symbols of an ELF file, as a dictionary"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    cache_path = os.path.join(CACHE_DIR, hashlib.sha1(data).hexdigest() + '.json')
+
+    if use_cache:
+        try:
+            with open(cache_path) as f:
+                return json.load(f)
+        except (OSError, ValueError):
+            pass
+
+    elf = Elf(path, data)
+    result = {
+        'entry': elf.entry,
+        'load_size': elf.load_size(),
+        'symbols': elf.symbols,
+        'flasher_id': None,
+    }
+    if 'flasher_id' in elf.symbols:
+        try:
+            result['flasher_id'] = list(struct.unpack('<3I', elf.read_symbol('flasher_id')))
+        except ValueError:
+            pass
+
+    if use_cache:
+        try:
+            os.makedirs(CACHE_DIR, exist_ok=True)
+            tmp_path = cache_path + '.%d' % os.getpid()
+            with open(tmp_path, 'w') as f:
+                json.dump(result, f)
+            os.replace(tmp_path, cache_path)
+        except OSError:
+            pass
+
+    return result
+
+
+def _pad4(data):
+    return data + b'\0' * (-len(data) % 4)
+
+
+def _note(name, n_type, desc):
+    name = name.encode() + b'\0'
+    return struct.pack('<3I', len(name), len(desc), n_type) + _pad4(name) + _pad4(desc)
+
+
+def write_core(path, threads, segments, flags=0):
+    """Write an ELF core file readable by gdb: threads is a list of (pid, regs)
+    with the 32 registers of a core in the order pc, x1 .. x31, segments a
+    list of (addr, size, data), data None for memory known to be zero"""
+    notes = b''
+    for pid, regs in threads:
+        # elf_prstatus of rv32 linux: pr_pid at 24, pr_reg at 72, 204 bytes,
+        # also what a bare-metal gdb reads from GDB 11 (see gap9-coredump)
+        prstatus = bytearray(204)
+        struct.pack_into('<I', prstatus, 24, pid)
+        struct.pack_into('<32I', prstatus, 72, *regs)
+        notes += _note('CORE', NT_PRSTATUS, bytes(prstatus))
+
+    phnum = 1 + len(segments)
+    offset = 52 + 32 * phnum
+    phdrs = struct.pack('<8I', PT_NOTE, offset, 0, 0, len(notes), 0, 0, 4)
+    offset += len(notes)
+    for addr, size, data in segments:
+        filesz = len(data) if data is not None else 0
+        phdrs += struct.pack('<8I', PT_LOAD, offset, addr, addr, filesz, size, PF_R | PF_W | PF_X, 4)
+        offset += filesz
+
+    ident = b'\x7fELF' + bytes([1, 1, 1]) + b'\0' * 9
+    ehdr = ident + struct.pack('<HHIIIIIHHHHHH', ET_CORE, EM_RISCV, 1, 0, 52, 0, flags, 52, 32, phnum, 40, 0, 0)
+    with open(path, 'wb') as f:
+        f.write(ehdr + phdrs + notes)
+        for _, _, data in segments:
+            if data is not None:
+                f.write(data)
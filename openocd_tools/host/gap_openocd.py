@@ -0,0 +1,93 @@
+#
+# Copyright (C) 2024 GreenWaves Technologies
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# openocd sessions of the host tools: either a one-shot openocd on the adapter,
+# or an openocd already running (gap9-service, tcl_port) reached through
+# gap_rpc. The scripts are those of openocd_tools/tcl.
+
+import glob
+import os
+import subprocess
+
+import gap_rpc
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+TCL_DIR = os.path.join(ROOT, 'openocd_tools', 'tcl')
+
+# same adapters as tcl/gapuino_ftdi.cfg
+FTDI_IDS = [('0403', '6010'), ('0403', '6011'), ('0403', '6012')]
+
+
+def default_openocd():
+    local = os.path.join(ROOT, 'openocd_ubuntu2204', 'bin', 'openocd')
+    return local if os.path.exists(local) else 'openocd'
+
+
+def adapter_khz():
+    """JTAG clock measured for the adapter by gap9-jtag-tune"""
+    try:
+        return subprocess.check_output([os.path.join(ROOT, 'openocd_tools', 'host', 'gap9-jtag-tune')],
+                                       universal_newlines=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return '5000'
+
+
+def sysfs_read(path):
+    try:
+        with open(path) as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+
+def adapter_serials():
+    """Serial numbers of the FTDI adapters plugged in"""
+    serials = []
+    for dev in sorted(glob.glob('/sys/bus/usb/devices/*')):
+        ids = (sysfs_read(os.path.join(dev, 'idVendor')), sysfs_read(os.path.join(dev, 'idProduct')))
+        serial = sysfs_read(os.path.join(dev, 'serial'))
+        if ids in FTDI_IDS and serial:
+            serials.append(serial)
+    return serials
+
+
+def run(openocd, scripts, tcl, variables=(), serial=None, tune=True):
+    """Output of openocd running tcl after the adapter config and scripts.
+    variables are (name, value) set before the configs, serial selects the
+    adapter."""
+    setup = ['gdb_port disabled', 'telnet_port disabled', 'tcl_port disabled']
+    if tune:
+        setup.append('set GAP_ADAPTER_KHZ %s' % adapter_khz())
+    setup += ['set %s %s' % (name, gap_rpc.tcl_quote(value)) for name, value in variables]
+    cmd = [openocd, '-s', 'openocd_tools', '-c', '; '.join(setup), '-f', 'openocd_tools/tcl/gapuino_ftdi.cfg']
+    if serial:
+        cmd += ['-c', 'ftdi_serial %s' % serial]
+    for script in scripts:
+        cmd += ['-f', 'openocd_tools/tcl/' + script]
+    cmd += ['-c', tcl]
+    # openocd prints on stderr
+    return subprocess.run(cmd, cwd=ROOT, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                          universal_newlines=True).stdout
+
+
+def connect(host, port, proc, scripts, timeout=None):
+    """Connection to a running openocd, scripts are sourced unless proc
+    already exists"""
+    rpc = gap_rpc.TclRpc(host, port, timeout)
+    if not rpc.command('info procs %s' % proc):
+        for script in scripts:
+            rpc.command('source {%s}' % os.path.join(TCL_DIR, script))
+    return rpc
@@ -0,0 +1,66 @@
+#
+# Copyright (C) 2024 GreenWaves Technologies
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Client of the openocd Tcl RPC server (tcl_port): a command is sent as text
+# terminated by 0x1a, its result comes back the same way.
+
+import re
+import socket
+
+RPC_PORT = 6666
+RPC_TERMINATOR = b'\x1a'
+
+
+class TclWord(str):
+    """Already a well formed Tcl list, passed as a single word"""
+    pass
+
+
+def tcl_quote(value):
+    """Quote a string as a single Tcl word"""
+    if isinstance(value, TclWord):
+        return '{' + value + '}'
+    value = str(value)
+    if value and re.match(r'^[A-Za-z0-9_./:+-]+$', value):
+        return value
+    if '{' not in value and '}' not in value and '\\' not in value:
+        return '{' + value + '}'
+    return '"' + re.sub(r'([\\"$\[\]{}])', r'\\\1', value) + '"'
+
+
+def tcl_list(values):
+    return ' '.join(tcl_quote(v) if not isinstance(v, (list, tuple)) else '{' + tcl_list(v) + '}'
+                    for v in values)
+
+
+class TclRpc(object):
+
+    def __init__(self, host='localhost', port=RPC_PORT, timeout=None):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.buff = b''
+
+    def command(self, cmd):
+        self.sock.sendall(cmd.encode() + RPC_TERMINATOR)
+        while RPC_TERMINATOR not in self.buff:
+            data = self.sock.recv(65536)
+            if not data:
+                raise ConnectionError('openocd closed the connection')
+            self.buff += data
+        result, self.buff = self.buff.split(RPC_TERMINATOR, 1)
+        return result.decode(errors='replace')
+
+    def close(self):
+        self.sock.close()
@@ -0,0 +1,37 @@
+#include "gap_bench.h"
+
+gap_bench_t gap_bench;
+
+void gap_bench_init(void *input, uint32_t input_size, uint32_t *perf, const char **names, uint32_t nb_layers)
+{
+    gap_bench.cmd = GAP_BENCH_CMD_NONE;
+    gap_bench.seq = 0;
+    gap_bench.input = input;
+    gap_bench.input_size = input_size;
+    gap_bench.perf = perf;
+    gap_bench.nb_layers = nb_layers;
+    gap_bench.names = names;
+    gap_bench.status = 0;
+    // the host waits for the magic before reading anything else
+    __asm__ volatile ("" : : : "memory");
+    gap_bench.magic = GAP_BENCH_MAGIC;
+}
+
+int gap_bench_wait(void)
+{
+    uint32_t cmd;
+    while((cmd = gap_bench.cmd) == GAP_BENCH_CMD_NONE)
+    {
+    }
+    // the input is written by the host before the command
+    __asm__ volatile ("" : : : "memory");
+    return cmd == GAP_BENCH_CMD_RUN;
+}
+
+void gap_bench_done(int32_t status)
+{
+    gap_bench.status = status;
+    __asm__ volatile ("" : : : "memory");
+    gap_bench.cmd = GAP_BENCH_CMD_NONE;
+    gap_bench.seq++;
+}
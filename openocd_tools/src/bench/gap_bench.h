@@ -0,0 +1,49 @@
+#ifndef __GAP_BENCH_H__
+#define __GAP_BENCH_H__
+
+#include <stdint.h>
+
+// Mailbox of the batch inference harness (tcl/bench.tcl, host/gap9-bench): the
+// application is loaded once, then for each input the host writes the input
+// tensor to the buffer published here and asks for a run, the application runs
+// the inference and publishes the cycles of each layer.
+//
+//     gap_bench_init(Input_1, INPUT_SIZE, AT_GraphPerf, AT_GraphNodeNames, NB_LAYERS);
+//     while(gap_bench_wait())
+//     {
+//         int status = mobilenetCNN(Output_1);
+//         gap_bench_done(status);
+//     }
+
+#define GAP_BENCH_MAGIC (0x48434247) // "GBCH"
+
+#define GAP_BENCH_CMD_NONE (0)
+#define GAP_BENCH_CMD_RUN  (1)
+#define GAP_BENCH_CMD_STOP (2)
+
+// Found by the host with the gap_bench symbol. Offsets are part of the
+// protocol with tcl/bench.tcl.
+typedef struct
+{
+    uint32_t magic;             // +0, set last by gap_bench_init
+    volatile uint32_t cmd;      // +4, set by the host, cleared by the application
+    volatile uint32_t seq;      // +8, number of runs done
+    void *input;                // +12
+    uint32_t input_size;        // +16
+    uint32_t *perf;             // +20, cycles of each layer of the last run
+    uint32_t nb_layers;         // +24
+    const char **names;         // +28, name of each layer, may be NULL
+    int32_t status;             // +32, result of the last run
+} gap_bench_t;
+
+extern gap_bench_t gap_bench;
+
+void gap_bench_init(void *input, uint32_t input_size, uint32_t *perf, const char **names, uint32_t nb_layers);
+
+// Waits for the host, returns 1 when the input is written and a run is
+// requested, 0 when the host is done
+int gap_bench_wait(void);
+
+void gap_bench_done(int32_t status);
+
+#endif
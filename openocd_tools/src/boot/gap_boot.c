@@ -0,0 +1,27 @@
+#include "gap_boot.h"
+
+gap_boot_t gap_boot = {
+    .magic = GAP_BOOT_MAGIC,
+    .stage = GAP_BOOT_STAGE_LOADED,
+    .main_cycles = 0,
+};
+
+// First C code of the application: runs right after the start code, before the
+// other constructors. The cycle counter of the FC (PCCR0) counts from here.
+__attribute__((constructor(101))) static void gap_boot_start(void)
+{
+    __asm__ volatile ("csrw 0xcc1, zero");        // PCMR: counters off
+    __asm__ volatile ("csrw 0x780, zero");        // PCCR0: cycles
+    __asm__ volatile ("csrw 0xcc0, %0" : : "r" (1)); // PCER: cycles only
+    __asm__ volatile ("csrw 0xcc1, %0" : : "r" (1)); // PCMR: counters on
+    gap_boot.stage = GAP_BOOT_STAGE_START;
+}
+
+void gap_boot_main(void)
+{
+    uint32_t cycles;
+    __asm__ volatile ("csrr %0, 0x780" : "=r" (cycles));
+    gap_boot.main_cycles = cycles;
+    __asm__ volatile ("" : : : "memory");
+    gap_boot.stage = GAP_BOOT_STAGE_MAIN;
+}
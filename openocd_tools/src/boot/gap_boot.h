@@ -0,0 +1,38 @@
+#ifndef __GAP_BOOT_H__
+#define __GAP_BOOT_H__
+
+#include <stdint.h>
+
+// Boot marker read by the boot profiler (tcl/boot_profile.tcl,
+// host/gap9-boot-profile): the host resets the board into MRAM or flash boot
+// and polls the marker over JTAG, the stages give the end of the load of the
+// image, the first C code of the application and main.
+//
+//     int main(void)
+//     {
+//         gap_boot_main();
+//         ...
+
+#define GAP_BOOT_MAGIC (0x544f4247) // "GBOT"
+
+// the marker is in .data: it appears with the stage loaded once the loader has
+// copied it to L2
+#define GAP_BOOT_STAGE_LOADED (0)
+#define GAP_BOOT_STAGE_START  (1)
+#define GAP_BOOT_STAGE_MAIN   (2)
+
+// Found by the host with the gap_boot symbol. Offsets are part of the protocol
+// with tcl/boot_profile.tcl.
+typedef struct
+{
+    uint32_t magic;                 // +0
+    volatile uint32_t stage;        // +4
+    volatile uint32_t main_cycles;  // +8, FC cycles from the start stage to main
+} gap_boot_t;
+
+extern gap_boot_t gap_boot;
+
+// Called at the beginning of main
+void gap_boot_main(void);
+
+#endif
@@ -1,3 +1,8 @@
+# no load size limit until the minimal flashers have been measured, give one
+# to fail the build above it
+FLASHER_MAX_LOAD_SIZE ?=
+SIZE_CHECK = ../../host/gap9-elf-size --verbose $(if $(FLASHER_MAX_LOAD_SIZE),--max-load $(FLASHER_MAX_LOAD_SIZE))
+
 gap9_evk:
 	$(MAKE) PMSIS_OS=freertos clean platform=fpga
 	$(MAKE) PMSIS_OS=freertos platform=fpga io=host all
@@ -8,6 +13,33 @@ gap9_evk:
 	$(MAKE) PMSIS_OS=freertos clean platform=board
 	$(MAKE) MRAM=1 PMSIS_OS=freertos platform=board io=host all
 	cp BUILD/GAP9_V2/GCC_RISCV_FREERTOS/gap_flasher ../../gap_bins/gap_flasher-gap9_evk-mram.elf
+	$(MAKE) PMSIS_OS=freertos clean platform=board
+	$(MAKE) DUAL=1 PMSIS_OS=freertos platform=board io=host all
+	cp BUILD/GAP9_V2/GCC_RISCV_FREERTOS/gap_flasher ../../gap_bins/gap_flasher-gap9_evk-dual.elf
+
+# Minimal flashers: bare metal (pulpos), no stdio, load size reported (and
+# checked against FLASHER_MAX_LOAD_SIZE when given)
+gap9_evk_min:
+	$(MAKE) PMSIS_OS=pulpos clean platform=board
+	$(MAKE) MINIMAL=1 PMSIS_OS=pulpos platform=board io=disable all
+	$(SIZE_CHECK) BUILD/GAP9_V2/GCC_RISCV_PULPOS/gap_flasher
+	cp BUILD/GAP9_V2/GCC_RISCV_PULPOS/gap_flasher ../../gap_bins/gap_flasher-gap9_evk-min.elf
+	$(MAKE) PMSIS_OS=pulpos clean platform=board
+	$(MAKE) MINIMAL=1 MRAM=1 PMSIS_OS=pulpos platform=board io=disable all
+	$(SIZE_CHECK) BUILD/GAP9_V2/GCC_RISCV_PULPOS/gap_flasher
+	cp BUILD/GAP9_V2/GCC_RISCV_PULPOS/gap_flasher ../../gap_bins/gap_flasher-gap9_evk-mram-min.elf
+
+# Load size and startup latency of the minimal flashers against the regular
+# ones, board connected: the numbers to record in README.md
+gap9_evk_min_bench:
+	../../host/gap9-elf-size ../../gap_bins/gap_flasher-gap9_evk.elf ../../gap_bins/gap_flasher-gap9_evk-min.elf \
+		../../gap_bins/gap_flasher-gap9_evk-mram.elf ../../gap_bins/gap_flasher-gap9_evk-mram-min.elf
+	cd ../.. && openocd -f tcl/gapuino_ftdi.cfg -f tcl/gap9revb.tcl -f tcl/flash_image.tcl \
+		-c "gap9_flasher_startup_bench {gap_bins/gap_flasher-gap9_evk.elf gap_bins/gap_flasher-gap9_evk-mram.elf}; exit"
+	cd ../.. && for elf in gap_bins/gap_flasher-gap9_evk-min.elf gap_bins/gap_flasher-gap9_evk-mram-min.elf; do \
+		openocd -f tcl/gapuino_ftdi.cfg -f tcl/gap9revb.tcl -f tcl/flash_image.tcl \
+			-c "gap9_flasher_startup_bench $$elf $$(host/gap9-elf-info --entry --symbol __rt_debug_struct_ptr $$elf); exit"; \
+	done
 
 gap9_v2:
 	$(MAKE) PMSIS_OS=freertos clean platform=board
@@ -3,16 +3,84 @@
 #include "bsp/flash.h"
 #include "bsp/flash/hyperflash.h"
 #include "bsp/flash/spiflash.h"
+#include <string.h>
 
 #define HYPER 0
 #define QSPI 1
 
 #define FLASH_SECTOR_SIZE (1<<18) // 256 KiB
 
+#ifdef USE_DUAL_FLASH
+// MRAM and OctoSPI are fed at the same time, halve the buffers so that both
+// devices fit in L2
+#define BUFF_SIZE (FLASH_SECTOR_SIZE >> 1)
+#else
 #define BUFF_SIZE (FLASH_SECTOR_SIZE)
+#endif
+
+// The minimal build is loaded as fast as possible over JTAG: no stdio at all,
+// the host only relies on the bridge to follow the flasher.
+#ifdef FLASHER_MINIMAL
+#define FLASHER_LOG(...) do { } while (0)
+#else
+#define FLASHER_LOG(...) printf(__VA_ARGS__)
+#endif
+
+// eMRAM is erased by 8 KiB sectors and programmed by 128 bits words
+#define MRAM_SECTOR_SIZE (1<<13) // 8 KiB
+#define MRAM_WORD_SIZE   (16)
+
+// smallest erase unit of the OctoSPI/SPI NOR flashes of the GAP9 boards
+#define FLASH_ERASE_SIZE (1<<12) // 4 KiB
+
+// Identity published in the bridge, the host reuses a flasher left running by a
+// previous command when it is the same build as the one it would load.
+#define FLASHER_MAGIC   (0x48534c46) // "FLSH"
+#define FLASHER_VERSION (6)
+#ifndef FLASHER_BUILD_HASH
+#define FLASHER_BUILD_HASH (0)
+#endif
+
+// host requests, written to the bridge ctrl field
+#define FLASHER_CTRL_NONE  (0)
+#define FLASHER_CTRL_RESET (1) // abort any session, back to FLASHER_WAIT_RUN
+#define FLASHER_CTRL_CALIB (2) // reset, then calibrate on the calib_addr sectors
+#define FLASHER_CTRL_HASH  (3) // reset, then hash the blocks of hash_* to the slot buffer
+
+// published in the bridge status field, the host stops waiting on the slots
+// as soon as it is not FLASHER_OK. A reset clears the errors of a session.
+#define FLASHER_OK            (0)
+#define FLASHER_ERR_VERIFY    (-1) // programmed content does not read back
+#define FLASHER_ERR_OPEN      (-3)
+#define FLASHER_ERR_ALLOC     (-4) // the flasher is not usable, load it again
+#define FLASHER_ERR_RESERVED  (-5) // chunk overlaps the calibration scratch sector
+#define FLASHER_ERR_HASH      (-6) // invalid hash request, or the device read failed
+
+// Speed calibration, only on request of the host (FLASHER_CTRL_CALIB): the
+// host gives in the bridge a scratch sector of each device it reserved for it,
+// the flasher never writes anywhere else on its own. FC/periph frequencies,
+// then the read baud rate of each device, are raised step by step. Each step is
+// validated by reading back several times a known pattern, written at the SDK
+// default settings to the scratch sector (only when it is not already there).
+// The fastest stable setting is kept until the next request, and the chunks
+// which overlap the scratch sector are refused. Only reads were validated:
+// erase and program always run at the SDK default baud rate.
+#ifndef FLASHER_NO_CALIBRATION
+#define CALIB_MRAM_SIZE  (MRAM_SECTOR_SIZE)
+#define CALIB_FLASH_SIZE (0x1000)
+#define CALIB_READS (4)
+static const uint32_t calib_freqs[] = {180000000, 240000000, 300000000, 360000000};
+static const uint32_t calib_mram_baudrates[] = {20000000, 30000000, 36000000, 45000000};
+static const uint32_t calib_flash_baudrates[] = {50000000, 100000000, 133000000, 166000000, 200000000};
+#define CALIB_NB(table) (sizeof(table) / sizeof((table)[0]))
+#define CALIB_SIZE(f) ((f)->is_mram ? CALIB_MRAM_SIZE : CALIB_FLASH_SIZE)
+#endif
+
+#define FLASHER_DEFAULT_FC_FREQ (180000000)
 
-PI_L2 unsigned char *buff;
-PI_L2 unsigned char *read_buff;
+// slot 0 drives the MRAM (MRAM and dual flashers) or the default flash,
+// slot 1 drives the default (OctoSPI) flash of the dual flasher
+#define FLASHER_NB_SLOTS (2)
 
 extern void *__rt_debug_struct_ptr;
 
@@ -21,93 +89,688 @@ typedef struct
     uint32_t host_ready;
     uint32_t gap_ready;
     uint32_t buff_pointer;
-    // size is ignored here
     uint32_t buff_size;
     uint32_t flash_run;
     uint32_t flash_addr;
     uint32_t flash_size;
     uint32_t flash_type;
+    // number of flash sectors rewritten / left untouched (already up to date)
+    uint32_t sectors_written;
+    uint32_t sectors_skipped;
+} flash_slot_t;
+
+typedef struct
+{
+    // slot 0 keeps the historical bridge layout, so that single device hosts
+    // keep working with any flasher
+    flash_slot_t slot[FLASHER_NB_SLOTS];
+    uint32_t magic;
+    uint32_t version;
+    uint32_t build_hash;
+    uint32_t ctrl;
+    // settings in use, after calibration (read baud rate, 0: SDK default)
+    uint32_t fc_freq;
+    uint32_t periph_freq;
+    uint32_t baudrate[FLASHER_NB_SLOTS];
+    // FLASHER_OK or the error which stopped a session
+    int32_t status;
+    // scratch sectors given by the host for FLASHER_CTRL_CALIB, 0: none
+    uint32_t calib_mram_addr;
+    uint32_t calib_flash_addr;
+    // FLASHER_CTRL_HASH request: the device of slot hash_slot is hashed by
+    // blocks of hash_block bytes over [hash_addr, hash_addr + hash_size[
+    uint32_t hash_slot;
+    uint32_t hash_addr;
+    uint32_t hash_size;
+    uint32_t hash_block;
 } bridge_t;
 
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t build_hash;
+} flasher_id_t;
+
+// also read by the host from the ELF file, see host/gap9-elf-info
+const flasher_id_t flasher_id = {FLASHER_MAGIC, FLASHER_VERSION, FLASHER_BUILD_HASH};
+
 bridge_t debug_struct = {0};
 
-static int test_entry(void)
+typedef enum
 {
-    pi_freq_set(PI_FREQ_DOMAIN_FC, 180000000);
-    printf("[Flasher]: MRAM flasher entry\n");
-    __rt_debug_struct_ptr = &debug_struct;
+    FLASHER_OFF,            // slot not handled by this build
+    FLASHER_WAIT_RUN,       // wait for the host to start a flash session
+    FLASHER_WAIT_HOST,      // wait for the host to be ready to send a chunk
+    FLASHER_WAIT_ACK,       // wait for the host to fill the buffer
+    FLASHER_READ,           // read the current MRAM sector
+    FLASHER_MERGE,          // merge the chunk into the MRAM sector
+    FLASHER_ERASE,
+    FLASHER_PROGRAM,
+    FLASHER_VERIFY,
+    FLASHER_CHECK,          // compare what was programmed, go to next sector
+    FLASHER_DONE,
+    FLASHER_IDLE,           // session is over, wait for a reset from the host
+    FLASHER_ERROR,          // session failed, wait for a reset from the host
+} flasher_state_e;
+
+typedef struct
+{
+    volatile flash_slot_t *slot;
     struct pi_device flash;
+    int is_mram;
+    unsigned char *buff;
+    unsigned char *read_buff;
+    // erase sector of the device, and the sector being rewritten
+    uint32_t sector_size;
+    unsigned char *sector_buff;
+    pi_task_t task;
+    // an asynchronous flash operation is in flight
+    volatile int busy;
+    flasher_state_e state;
+    // calibrated read baud rate, 0 to keep the SDK default
+    uint32_t baudrate;
+    // SDK default baud rate, used to erase and program
+    uint32_t safe_baudrate;
+    // baud rate the device is currently set to
+    uint32_t cur_baudrate;
+    // scratch sector of the last calibration, 0: none
+    uint32_t calib_addr;
+    // chunk being written and current unit of work: a sector for the MRAM,
+    // the whole chunk otherwise
+    uint32_t chunk_addr;
+    uint32_t chunk_end;
+    uint32_t addr;
+    uint32_t size;
+    // what is actually erased/programmed for this unit of work
+    uint32_t prog_addr;
+    uint32_t prog_size;
+    unsigned char *prog_src;
+} flasher_t;
+
+static flasher_t flashers[FLASHER_NB_SLOTS];
 
-    buff = (unsigned char *) pi_l2_malloc ((uint32_t) BUFF_SIZE);
-    read_buff = (unsigned char *) pi_l2_malloc ((uint32_t) BUFF_SIZE);
-    if(buff == NULL)
+// periph frequency set by the runtime, restored before each calibration
+static uint32_t flasher_default_periph_freq;
+
+static void flasher_op_done(void *arg)
+{
+    flasher_t *f = (flasher_t *) arg;
+    f->busy = 0;
+}
+
+// Reads run at the calibrated baud rate, erase and program at the SDK default
+static void flasher_set_baudrate(flasher_t *f, uint32_t baudrate)
+{
+    if(baudrate && baudrate != f->cur_baudrate)
     {
-        printf("[Flasher]: l2 alloc failed\n");
-        pmsis_exit(-1);
+        pi_flash_ioctl(&f->flash, PI_FLASH_IOCTL_SET_BAUDRATE, (void *) baudrate);
+        f->cur_baudrate = baudrate;
     }
+}
 
-    *(volatile uint32_t *)&debug_struct.buff_pointer = (uint32_t) buff;
+static pi_task_t *flasher_op_start(flasher_t *f, flasher_state_e next)
+{
+    f->busy = 1;
+    f->state = next;
+    return pi_task_callback(&f->task, flasher_op_done, (void *) f);
+}
 
-    *(volatile uint32_t *)&debug_struct.gap_ready = 1;
-#ifdef USE_MRAM
-    printf("[Flasher]: MRAM flasher is ready\n");
-#else
-    printf("[Flasher]: Default flasher is ready\n");
-#endif
-    while((*(volatile uint32_t *)&debug_struct.flash_run) == 0)
+static int flasher_init(flasher_t *f, int slot, int is_mram)
+{
+    f->slot = &debug_struct.slot[slot];
+    f->is_mram = is_mram;
+    f->buff = (unsigned char *) pi_l2_malloc ((uint32_t) BUFF_SIZE);
+    f->read_buff = (unsigned char *) pi_l2_malloc ((uint32_t) BUFF_SIZE);
+    f->sector_size = is_mram ? MRAM_SECTOR_SIZE : FLASH_ERASE_SIZE;
+    f->sector_buff = (unsigned char *) pi_l2_malloc (f->sector_size);
+    if(f->buff == NULL || f->read_buff == NULL || f->sector_buff == NULL)
     {
-        pi_time_wait_us(1);
+        return -1;
     }
 
-#ifdef USE_MRAM
-    struct pi_mram_conf flash_conf;
-    pi_mram_conf_init(&flash_conf);
-#else
-    struct pi_default_flash_conf flash_conf;
-    pi_default_flash_conf_init(&flash_conf);
+    if(is_mram)
+    {
+        struct pi_mram_conf flash_conf;
+        pi_mram_conf_init(&flash_conf);
+        pi_open_from_conf(&f->flash, &flash_conf);
+        f->safe_baudrate = flash_conf.baudrate;
+    }
+    else
+    {
+        struct pi_default_flash_conf flash_conf;
+        pi_default_flash_conf_init(&flash_conf);
+        pi_open_from_conf(&f->flash, &flash_conf);
+        f->safe_baudrate = flash_conf.baudrate;
+    }
+
+    f->slot->buff_pointer = (uint32_t) f->buff;
+    f->slot->buff_size = (uint32_t) BUFF_SIZE;
+    f->slot->gap_ready = 1;
+    f->state = FLASHER_WAIT_RUN;
+    return 0;
+}
+
+// Select the next unit of work of the current chunk.
+// MRAM chunks are handled one 8 KiB sector at a time: sectors whose content
+// already matches are skipped. The whole OctoSPI sectors of a chunk are erased
+// and programmed at once. The bytes of a partially covered sector which are
+// outside of the chunk are preserved on both devices (read, merge, rewrite),
+// so that a small blob can be patched at any offset.
+static void flasher_next(flasher_t *f)
+{
+    if(f->addr + f->size >= f->chunk_end)
+    {
+        f->state = (f->slot->flash_run) ? FLASHER_WAIT_HOST : FLASHER_DONE;
+        return;
+    }
+
+    f->addr += f->size;
+    uint32_t sector = f->addr & ~(f->sector_size - 1);
+    uint32_t whole_end = f->chunk_end & ~(f->sector_size - 1);
+    if(f->is_mram || f->addr != sector || whole_end <= f->addr)
+    {
+        uint32_t stop = sector + f->sector_size;
+        f->size = ((stop > f->chunk_end) ? f->chunk_end : stop) - f->addr;
+        // the sector is always programmed as a whole, hence with a size and
+        // an address aligned on MRAM words
+        f->prog_addr = sector;
+        f->prog_size = f->sector_size;
+        f->prog_src = f->sector_buff;
+        f->state = FLASHER_READ;
+    }
+    else
+    {
+        f->size = whole_end - f->addr;
+        f->prog_addr = f->addr;
+        f->prog_size = f->size;
+        f->prog_src = f->buff;
+        f->state = FLASHER_ERASE;
+    }
+}
+
+// Move the state machine of a slot forward. Flash operations are issued
+// asynchronously so that the MRAM and OctoSPI controllers work in parallel,
+// the FC only moves from one operation to the next one.
+static int flasher_step(flasher_t *f)
+{
+    volatile flash_slot_t *slot = f->slot;
+
+    if(f->busy)
+    {
+        return 0;
+    }
+
+    switch(f->state)
+    {
+        case FLASHER_WAIT_RUN:
+            if(slot->flash_run == 0)
+            {
+                break;
+            }
+            if (pi_flash_open(&f->flash))
+            {
+                FLASHER_LOG("pi_flash_open failed\n");
+                return FLASHER_ERR_OPEN;
+            }
+            // a device is opened at the SDK default baud rate
+            f->cur_baudrate = f->safe_baudrate;
+            f->state = FLASHER_WAIT_HOST;
+            break;
+
+        case FLASHER_WAIT_HOST:
+            if(slot->host_ready == 0)
+            {
+                break;
+            }
+            slot->gap_ready = 1;
+            f->state = FLASHER_WAIT_ACK;
+            break;
+
+        case FLASHER_WAIT_ACK:
+            if(slot->gap_ready == 1)
+            {
+                break;
+            }
+            f->chunk_addr = slot->flash_addr;
+            f->chunk_end = slot->flash_addr + slot->flash_size;
+#ifndef FLASHER_NO_CALIBRATION
+            if(f->calib_addr && f->chunk_addr < f->calib_addr + CALIB_SIZE(f)
+                && f->chunk_end > f->calib_addr)
+            {
+                FLASHER_LOG("[Flasher]: chunk overlaps the calibration sector 0x%x\n",
+                        f->calib_addr);
+                return FLASHER_ERR_RESERVED;
+            }
 #endif
+            f->addr = f->chunk_addr;
+            f->size = 0;
+            flasher_next(f);
+            break;
+
+        case FLASHER_READ:
+            flasher_set_baudrate(f, f->baudrate);
+            pi_flash_read_async(&f->flash, f->prog_addr, (void*)f->sector_buff,
+                    f->prog_size, flasher_op_start(f, FLASHER_MERGE));
+            break;
+
+        case FLASHER_MERGE:
+        {
+            unsigned char *src = f->buff + (f->addr - f->chunk_addr);
+            unsigned char *dst = f->sector_buff + (f->addr - f->prog_addr);
+            if(!memcmp(dst, src, f->size))
+            {
+                slot->sectors_skipped++;
+                flasher_next(f);
+                break;
+            }
+            memcpy(dst, src, f->size);
+            f->state = FLASHER_ERASE;
+            break;
+        }
+
+        case FLASHER_ERASE:
+            flasher_set_baudrate(f, f->safe_baudrate);
+            if(f->is_mram)
+            {
+                pi_flash_erase_sector_async(&f->flash, f->prog_addr,
+                        flasher_op_start(f, FLASHER_PROGRAM));
+            }
+            else
+            {
+                pi_flash_erase_async(&f->flash, f->prog_addr, f->prog_size,
+                        flasher_op_start(f, FLASHER_PROGRAM));
+            }
+            break;
+
+        case FLASHER_PROGRAM:
+            pi_flash_program_async(&f->flash, f->prog_addr, (void*)f->prog_src,
+                    f->prog_size, flasher_op_start(f, FLASHER_VERIFY));
+            break;
+
+        case FLASHER_VERIFY:
+            flasher_set_baudrate(f, f->baudrate);
+            pi_flash_read_async(&f->flash, f->prog_addr, (void*)f->read_buff,
+                    f->prog_size, flasher_op_start(f, FLASHER_CHECK));
+            break;
+
+        case FLASHER_CHECK:
+            for(int i = 0; i < f->prog_size; i++)
+            {
+                if(f->prog_src[i] != f->read_buff[i])
+                {
+                    FLASHER_LOG("error, bytes do not match buff[%i]=0x%x read_buff[%i]=0x%x",
+                            i, f->prog_src[i], i, f->read_buff[i]);
+                    pi_flash_close(&f->flash);
+                    return FLASHER_ERR_VERIFY;
+                }
+            }
+            slot->sectors_written++;
+            flasher_next(f);
+            break;
+
+        case FLASHER_DONE:
+            FLASHER_LOG("[Flasher]: slot %d is done (%d sectors written, %d skipped)\n",
+                    (int) (f - flashers), slot->sectors_written,
+                    slot->sectors_skipped);
+            slot->flash_run = 1;
+            pi_flash_close(&f->flash);
+            f->state = FLASHER_IDLE;
+            break;
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+#ifndef FLASHER_NO_CALIBRATION
+// Content of the scratch sector: pseudo-random words, so that every data line
+// toggles at the highest rate
+static void flasher_calib_pattern(unsigned char *buff, uint32_t size)
+{
+    uint32_t x = 0x2545f491;
+    for(uint32_t i = 0; i < size; i += 4)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *(uint32_t *) (buff + i) = x;
+    }
+}
+
+// Read the scratch sector a few times, 0 if it always matches the pattern
+static int flasher_calib_check(flasher_t *f)
+{
+    for(int i = 0; i < CALIB_READS; i++)
+    {
+        memset(f->buff, 0, CALIB_SIZE(f));
+        if(pi_flash_read(&f->flash, f->calib_addr, f->buff, CALIB_SIZE(f))
+            || memcmp(f->buff, f->read_buff, CALIB_SIZE(f)))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Write the pattern to the scratch sector, at the SDK default settings, unless
+// it is already there. 0 if it reads back.
+static int flasher_calib_prepare(flasher_t *f)
+{
+    uint32_t addr = f->calib_addr;
+    uint32_t size = CALIB_SIZE(f);
 
-    pi_open_from_conf(&flash, &flash_conf);
-    if (pi_flash_open(&flash))
+    flasher_calib_pattern(f->read_buff, size);
+    if(pi_flash_read(&f->flash, addr, f->buff, size))
+    {
+        return -1;
+    }
+    if(!memcmp(f->buff, f->read_buff, size))
+    {
+        return 0;
+    }
+    int err = f->is_mram ? pi_flash_erase_sector(&f->flash, addr)
+                         : pi_flash_erase(&f->flash, addr, size);
+    if(err || pi_flash_program(&f->flash, addr, f->read_buff, size))
     {
-        printf("pi_flash_open failed\n");
-        pmsis_exit(-3);
+        return -1;
     }
+    return flasher_calib_check(f);
+}
 
-    while(debug_struct.flash_run)
+static int flasher_calib_check_all(void)
+{
+    for(int i = 0; i < FLASHER_NB_SLOTS; i++)
     {
-        while((*(volatile uint32_t *)&debug_struct.host_ready) == 0)
+        if(flashers[i].calib_addr && flasher_calib_check(&flashers[i]))
         {
-            pi_time_wait_us(1);
+            return -1;
         }
+    }
+    return 0;
+}
 
-        *(volatile uint32_t *)&debug_struct.gap_ready = 1;
-        // wait for ACK
-        while((*(volatile uint32_t *)&debug_struct.gap_ready) == 1)
+static void flasher_calibrate_baudrate(flasher_t *f)
+{
+    const uint32_t *baudrates = f->is_mram ? calib_mram_baudrates : calib_flash_baudrates;
+    int nb = f->is_mram ? CALIB_NB(calib_mram_baudrates) : CALIB_NB(calib_flash_baudrates);
+
+    f->baudrate = 0;
+    for(int i = 0; i < nb; i++)
+    {
+        pi_flash_ioctl(&f->flash, PI_FLASH_IOCTL_SET_BAUDRATE, (void *) baudrates[i]);
+        if(flasher_calib_check(f))
         {
-            pi_time_wait_us(1);
+            break;
         }
+        f->baudrate = baudrates[i];
+    }
+}
+
+// Calibrate on the scratch sectors published by the host, the settings are
+// back to the defaults for the devices without one
+static void flasher_calibrate(void)
+{
+    uint32_t periph_freq = flasher_default_periph_freq;
+    uint32_t fc_freq = FLASHER_DEFAULT_FC_FREQ;
+    int nb_calib = 0;
+    int nb_slots = 0;
+
+    pi_freq_set(PI_FREQ_DOMAIN_FC, fc_freq);
+    pi_freq_set(PI_FREQ_DOMAIN_PERIPH, periph_freq);
+    for(int i = 0; i < FLASHER_NB_SLOTS; i++)
+    {
+        flasher_t *f = &flashers[i];
+        f->baudrate = 0;
+        f->calib_addr = 0;
+        if(f->state == FLASHER_OFF)
+        {
+            continue;
+        }
+        uint32_t addr = f->is_mram ? debug_struct.calib_mram_addr : debug_struct.calib_flash_addr;
+        if(addr & (CALIB_SIZE(f) - 1))
+        {
+            FLASHER_LOG("[Flasher]: slot %d, calibration sector 0x%x is not aligned\n", i, addr);
+            continue;
+        }
+        f->calib_addr = addr;
+        nb_calib += addr != 0;
+        nb_slots++;
+    }
+    if(nb_calib == 0)
+    {
+        return;
+    }
 
-        // Erase and write the sector pointed by current_flash_addr
-        pi_flash_erase(&flash, debug_struct.flash_addr, debug_struct.flash_size);
-        pi_flash_program(&flash, debug_struct.flash_addr, (void*)buff,
-                debug_struct.flash_size);
-        pi_flash_read(&flash, debug_struct.flash_addr, (void*)read_buff,
-                debug_struct.flash_size);
-        for(int i = 0; i <debug_struct.flash_size; i++)
+    // reference content, at the SDK default settings. The scratch sectors stay
+    // reserved even when the calibration is skipped, the host gave them.
+    for(int i = 0; i < FLASHER_NB_SLOTS; i++)
+    {
+        flasher_t *f = &flashers[i];
+        if(!f->calib_addr)
         {
-            if(buff[i] != read_buff[i])
+            continue;
+        }
+        int err = pi_flash_open(&f->flash);
+        if(err || flasher_calib_prepare(f))
+        {
+            FLASHER_LOG("[Flasher]: calibration skipped\n");
+            for(int j = err ? i - 1 : i; j >= 0; j--)
             {
-                printf("error, bytes do not match buff[%i]=0x%x read_buff[%i]=0x%x",
-                        i, buff[i],i, read_buff[i]);
-                pmsis_exit(-1);
+                if(flashers[j].calib_addr)
+                {
+                    pi_flash_close(&flashers[j].flash);
+                }
             }
+            return;
+        }
+    }
+
+    // the frequencies apply to every device, they are only raised when all of
+    // them can be checked
+    for(int i = 0; i < (int) CALIB_NB(calib_freqs) && nb_calib == nb_slots; i++)
+    {
+        if(calib_freqs[i] <= fc_freq)
+        {
+            continue;
+        }
+        if(pi_freq_set(PI_FREQ_DOMAIN_FC, calib_freqs[i])
+            || pi_freq_set(PI_FREQ_DOMAIN_PERIPH, calib_freqs[i])
+            || flasher_calib_check_all())
+        {
+            pi_freq_set(PI_FREQ_DOMAIN_FC, fc_freq);
+            pi_freq_set(PI_FREQ_DOMAIN_PERIPH, periph_freq);
+            break;
+        }
+        fc_freq = calib_freqs[i];
+        periph_freq = calib_freqs[i];
+    }
+
+    // a device is reopened for each session, the baud rate is applied again
+    // by FLASHER_WAIT_RUN
+    for(int i = 0; i < FLASHER_NB_SLOTS; i++)
+    {
+        flasher_t *f = &flashers[i];
+        if(!f->calib_addr)
+        {
+            continue;
+        }
+        flasher_calibrate_baudrate(f);
+        pi_flash_close(&f->flash);
+        FLASHER_LOG("[Flasher]: slot %d baudrate %d\n", i, f->baudrate);
+    }
+    FLASHER_LOG("[Flasher]: FC %d Hz, periph %d Hz\n", fc_freq, periph_freq);
+}
+#endif
+
+// Reset the protocol state of a slot so that a new session can start, the
+// flash operation in flight (if any) is completed first.
+static void flasher_reset(flasher_t *f)
+{
+    volatile flash_slot_t *slot = f->slot;
+
+    if(f->state == FLASHER_OFF)
+    {
+        return;
+    }
+    while(f->busy)
+    {
+        pi_time_wait_us(1);
+    }
+    if(f->state != FLASHER_WAIT_RUN && f->state != FLASHER_IDLE
+        && f->state != FLASHER_ERROR)
+    {
+        pi_flash_close(&f->flash);
+    }
+    slot->host_ready = 0;
+    slot->flash_run = 0;
+    slot->sectors_written = 0;
+    slot->sectors_skipped = 0;
+    slot->gap_ready = 1;
+    f->state = FLASHER_WAIT_RUN;
+}
+
+// Hash the blocks requested by the host in the buffer of the slot, one FNV-1a
+// of the 32 bits words per block (as host/gap_elf.py block_hash), so that the
+// host can check what a device holds without reading it over JTAG. The last
+// block may be shorter, its partial word is padded with zeros.
+static int flasher_hash(void)
+{
+    uint32_t i = debug_struct.hash_slot;
+    uint32_t addr = debug_struct.hash_addr;
+    uint32_t size = debug_struct.hash_size;
+    uint32_t block = debug_struct.hash_block;
+
+    if(i >= FLASHER_NB_SLOTS || flashers[i].state == FLASHER_OFF
+        || block == 0 || (block & 3) || block > BUFF_SIZE
+        || (size / block + (size % block != 0)) > BUFF_SIZE / 4)
+    {
+        return FLASHER_ERR_HASH;
+    }
+
+    flasher_t *f = &flashers[i];
+    uint32_t *hashes = (uint32_t *) f->buff;
+    uint32_t *words = (uint32_t *) f->read_buff;
+    if(pi_flash_open(&f->flash))
+    {
+        return FLASHER_ERR_OPEN;
+    }
+    f->cur_baudrate = f->safe_baudrate;
+    flasher_set_baudrate(f, f->baudrate);
+
+    int err = FLASHER_OK;
+    for(uint32_t n = 0; size; n++)
+    {
+        uint32_t len = size < block ? size : block;
+        words[(len - 1) / 4] = 0;
+        if(pi_flash_read(&f->flash, addr, f->read_buff, len))
+        {
+            err = FLASHER_ERR_HASH;
+            break;
+        }
+        uint32_t h = 0x811c9dc5;
+        for(uint32_t w = 0; w < (len + 3) / 4; w++)
+        {
+            h = (h ^ words[w]) * 0x01000193;
         }
+        hashes[n] = h;
+        addr += len;
+        size -= len;
+    }
+    pi_flash_close(&f->flash);
+    return err;
+}
+
+static void flasher_publish_settings(void)
+{
+    debug_struct.fc_freq = pi_freq_get(PI_FREQ_DOMAIN_FC);
+    debug_struct.periph_freq = pi_freq_get(PI_FREQ_DOMAIN_PERIPH);
+    for(int i = 0; i < FLASHER_NB_SLOTS; i++)
+    {
+        debug_struct.baudrate[i] = flashers[i].baudrate;
+    }
+}
+
+static int test_entry(void)
+{
+    pi_freq_set(PI_FREQ_DOMAIN_FC, FLASHER_DEFAULT_FC_FREQ);
+    flasher_default_periph_freq = pi_freq_get(PI_FREQ_DOMAIN_PERIPH);
+    FLASHER_LOG("[Flasher]: MRAM flasher entry\n");
+    __rt_debug_struct_ptr = &debug_struct;
+
+#if defined(USE_DUAL_FLASH)
+    int err = flasher_init(&flashers[0], 0, 1);
+    err |= flasher_init(&flashers[1], 1, 0);
+#elif defined(USE_MRAM)
+    int err = flasher_init(&flashers[0], 0, 1);
+#else
+    int err = flasher_init(&flashers[0], 0, 0);
+#endif
+    if(err)
+    {
+        // published with the identity so that the host does not wait for GAP
+        // RDY, and never answers a reset: the host loads the flasher again
+        FLASHER_LOG("[Flasher]: l2 alloc failed\n");
+        debug_struct.status = FLASHER_ERR_ALLOC;
+        debug_struct.version = flasher_id.version;
+        debug_struct.build_hash = flasher_id.build_hash;
+        *(volatile uint32_t *)&debug_struct.magic = flasher_id.magic;
+        while(1);
     }
 
-    printf("[Flasher]: flasher is done\n");
-    *(volatile uint32_t *)&debug_struct.flash_run = 1;
-    pi_flash_close(&flash);
+#if defined(USE_DUAL_FLASH)
+    FLASHER_LOG("[Flasher]: MRAM + OctoSPI flasher is ready\n");
+#elif defined(USE_MRAM)
+    FLASHER_LOG("[Flasher]: MRAM flasher is ready\n");
+#else
+    FLASHER_LOG("[Flasher]: Default flasher is ready\n");
+#endif
+
+    flasher_publish_settings();
+
+    debug_struct.version = flasher_id.version;
+    debug_struct.build_hash = flasher_id.build_hash;
+    *(volatile uint32_t *)&debug_struct.magic = flasher_id.magic;
+
+    while(1)
+    {
+        uint32_t ctrl = *(volatile uint32_t *)&debug_struct.ctrl;
+        if(ctrl == FLASHER_CTRL_RESET || ctrl == FLASHER_CTRL_CALIB
+            || ctrl == FLASHER_CTRL_HASH)
+        {
+            int32_t status = FLASHER_OK;
+            for(int i = 0; i < FLASHER_NB_SLOTS; i++)
+            {
+                flasher_reset(&flashers[i]);
+            }
+#ifndef FLASHER_NO_CALIBRATION
+            if(ctrl == FLASHER_CTRL_CALIB)
+            {
+                flasher_calibrate();
+                flasher_publish_settings();
+            }
+#endif
+            if(ctrl == FLASHER_CTRL_HASH)
+            {
+                status = flasher_hash();
+            }
+            *(volatile int32_t *)&debug_struct.status = status;
+            *(volatile uint32_t *)&debug_struct.ctrl = FLASHER_CTRL_NONE;
+        }
+        for(int i = 0; i < FLASHER_NB_SLOTS; i++)
+        {
+            int ret = flasher_step(&flashers[i]);
+            if(ret)
+            {
+                // the flasher stays in L2, the host reads the error from the
+                // bridge instead of waiting for GAP RDY
+                flashers[i].state = FLASHER_ERROR;
+                *(volatile int32_t *)&debug_struct.status = ret;
+            }
+        }
+        pi_time_wait_us(1);
+    }
     return 0;
     // -------------------------------------------------------- //
 }
@@ -0,0 +1,4 @@
+#include "gap_hotpatch.h"
+
+// code is executed from it, it must stay in L2
+uint8_t gap_hotpatch_area[GAP_HOTPATCH_SIZE] __attribute__((aligned(4), used));
@@ -0,0 +1,17 @@
+#ifndef __GAP_HOTPATCH_H__
+#define __GAP_HOTPATCH_H__
+
+#include <stdint.h>
+
+// Patch area of the hot patch tool (tcl/hotpatch.tcl, host/gap9-hotpatch): the
+// new code of the functions changed since the application was loaded is
+// written here over JTAG, and the old functions jump to it.
+
+#ifndef GAP_HOTPATCH_SIZE
+#define GAP_HOTPATCH_SIZE (16384)
+#endif
+
+// Found by the host with the gap_hotpatch_area symbol, in L2
+extern uint8_t gap_hotpatch_area[GAP_HOTPATCH_SIZE];
+
+#endif
@@ -0,0 +1,82 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "gap_rtt.h"
+
+static char gap_rtt_data[GAP_RTT_BUFFER_SIZE];
+
+gap_rtt_t gap_rtt = {
+    .magic = GAP_RTT_MAGIC,
+    .buffer = gap_rtt_data,
+    .size = GAP_RTT_BUFFER_SIZE,
+    .wr = 0,
+    .rd = 0,
+    .mode = GAP_RTT_MODE,
+    .dropped = 0,
+};
+
+int gap_rtt_write(const void *data, uint32_t size)
+{
+    const char *src = (const char *) data;
+    uint32_t wr = gap_rtt.wr;
+    uint32_t written = 0;
+
+    while(written < size)
+    {
+        // one byte is kept free, wr == rd means empty
+        uint32_t rd = gap_rtt.rd;
+        uint32_t room = (rd + gap_rtt.size - wr - 1) % gap_rtt.size;
+        if(room == 0)
+        {
+            if(gap_rtt.mode == GAP_RTT_MODE_BLOCK)
+            {
+                continue;
+            }
+            gap_rtt.dropped += size - written;
+            break;
+        }
+        uint32_t len = size - written;
+        if(len > room)
+        {
+            len = room;
+        }
+        if(len > gap_rtt.size - wr)
+        {
+            len = gap_rtt.size - wr;
+        }
+        memcpy(gap_rtt.buffer + wr, src + written, len);
+        written += len;
+        wr += len;
+        if(wr == gap_rtt.size)
+        {
+            wr = 0;
+        }
+        // the data must be in L2 before the host sees the new index
+        __asm__ volatile ("" : : : "memory");
+        gap_rtt.wr = wr;
+    }
+    return written;
+}
+
+int gap_rtt_puts(const char *str)
+{
+    return gap_rtt_write(str, strlen(str));
+}
+
+int gap_rtt_printf(const char *fmt, ...)
+{
+    char buff[GAP_RTT_PRINTF_SIZE];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(buff, sizeof(buff), fmt, ap);
+    va_end(ap);
+    if(len < 0)
+    {
+        return len;
+    }
+    if(len >= (int) sizeof(buff))
+    {
+        len = sizeof(buff) - 1;
+    }
+    return gap_rtt_write(buff, len);
+}
@@ -0,0 +1,54 @@
+#ifndef __GAP_RTT_H__
+#define __GAP_RTT_H__
+
+#include <stdint.h>
+
+// Log channel read by the host over JTAG (tcl/rtt.tcl, host/gap9-rtt) while the
+// application runs: writing a message is a copy to a ring buffer in L2, the
+// core is never halted as with semihosting.
+//
+// The ring buffer has a single writer: messages from several cores or from
+// interrupt handlers must be serialized by the application.
+
+#ifndef GAP_RTT_BUFFER_SIZE
+#define GAP_RTT_BUFFER_SIZE (4096)
+#endif
+
+#define GAP_RTT_MAGIC (0x54545247) // "GRTT"
+
+// when the buffer is full: drop what does not fit (counted in dropped), or
+// wait for the host to read it
+#define GAP_RTT_MODE_DROP  (0)
+#define GAP_RTT_MODE_BLOCK (1)
+
+#ifndef GAP_RTT_MODE
+#define GAP_RTT_MODE GAP_RTT_MODE_DROP
+#endif
+
+// Control block, found by the host with the gap_rtt symbol. Offsets are part of
+// the protocol with tcl/rtt.tcl.
+typedef struct
+{
+    uint32_t magic;         // +0
+    char *buffer;           // +4
+    uint32_t size;          // +8
+    volatile uint32_t wr;   // +12, written by the application only
+    volatile uint32_t rd;   // +16, written by the host only
+    uint32_t mode;          // +20
+    uint32_t dropped;       // +24, bytes dropped since the start
+} gap_rtt_t;
+
+extern gap_rtt_t gap_rtt;
+
+// Returns the number of bytes written, less than size only in drop mode
+int gap_rtt_write(const void *data, uint32_t size);
+
+int gap_rtt_puts(const char *str);
+
+// Formatted in a buffer of GAP_RTT_PRINTF_SIZE bytes on the stack
+#ifndef GAP_RTT_PRINTF_SIZE
+#define GAP_RTT_PRINTF_SIZE (128)
+#endif
+int gap_rtt_printf(const char *fmt, ...);
+
+#endif
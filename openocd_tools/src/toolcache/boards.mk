@@ -0,0 +1,11 @@
+# The loader is built with CMake, the only build which reads sdk.config: the
+# pmsis Makefile rules would ignore CONFIG_LINKER_SCRIPT_UPPER_MEMORY and link
+# it at the bottom of L2, where gap9-toolcache refuses every tool.
+gap9_evk:
+	rm -rf build build-mram
+	cmake -B build
+	cmake --build build
+	cp build/gap_toolcache ../../gap_bins/gap_toolcache-gap9_evk.elf
+	cmake -B build-mram -DMRAM=1
+	cmake --build build-mram
+	cp build-mram/gap_toolcache ../../gap_bins/gap_toolcache-gap9_evk-mram.elf
@@ -0,0 +1,207 @@
+#include "pmsis.h"
+#include "bsp/bsp.h"
+#include "bsp/flash.h"
+#include <string.h>
+
+// Tool cache loader: stays in L2 and copies the tool images cached in a
+// reserved region of the OctoSPI flash (or of the MRAM with USE_MRAM) to their
+// load addresses, see tcl/toolcache.tcl and host/gap9-toolcache. It is linked
+// in the upper part of L2 (sdk.config, CMake build only) so that the images,
+// linked at the bottom of L2 like any application, never overwrite its code:
+// the host restarts it with an incremental load, identified by its bridge and
+// the hash of its blocks since __rt_debug_struct_ptr belongs to the last
+// application.
+//
+// A cached image is a table of segments followed by their content:
+//   {addr, filesz, memsz} x nb_segments, then the segments, each padded to 4
+// The whole image is read into the buffer by uDMA first and checked against the
+// hash given by the host (FNV-1a of its 32 bits words, the hash of the cache
+// index), so that a corrupted or overwritten slot is refused while the loader
+// can still answer. It is then copied to its load addresses with the
+// interrupts disabled: the runtime of the loader, which
+// the image replaces, is never run again. The host then starts the image at
+// its entry point through JTAG, and restarts the loader from its entry point
+// the next time.
+
+#define TOOLCACHE_MAGIC   (0x4c435447) // "GTCL"
+#define TOOLCACHE_VERSION (2)
+#ifndef TOOLCACHE_BUILD_HASH
+#define TOOLCACHE_BUILD_HASH (0)
+#endif
+
+#ifndef TOOLCACHE_BUFF_SIZE
+#define TOOLCACHE_BUFF_SIZE (128 * 1024)
+#endif
+
+// host requests, written to the cmd field once the arguments are set
+#define TOOLCACHE_CMD_NONE (0)
+#define TOOLCACHE_CMD_READ (1) // copy arg1 bytes at flash address arg0 to buff
+#define TOOLCACHE_CMD_RUN  (2) // load the image of arg1 segments at flash address arg0,
+                               // whose hash is arg2
+
+#define TOOLCACHE_OK         (1)
+#define TOOLCACHE_ERR_OPEN   (-1)
+#define TOOLCACHE_ERR_READ   (-2)
+#define TOOLCACHE_ERR_SIZE   (-3)
+#define TOOLCACHE_ERR_HASH   (-4) // the image in flash is not the expected one
+
+typedef struct
+{
+    uint32_t addr;
+    uint32_t filesz;
+    uint32_t memsz;
+} toolcache_segment_t;
+
+// Bridge with the host, found with the gap_toolcache symbol of the ELF
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t build_hash;
+    uint32_t cmd;
+    int32_t status;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint32_t buff;
+    uint32_t buff_size;
+    uint32_t arg2;
+} toolcache_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t build_hash;
+} toolcache_id_t;
+
+extern void *__rt_debug_struct_ptr;
+
+// also read by the host from the ELF file, to reuse a loader still waiting
+// for commands
+const toolcache_id_t toolcache_id = {TOOLCACHE_MAGIC, TOOLCACHE_VERSION, TOOLCACHE_BUILD_HASH};
+
+toolcache_t gap_toolcache = {0};
+
+static uint8_t toolcache_buff[TOOLCACHE_BUFF_SIZE] __attribute__((aligned(16)));
+
+static struct pi_device flash;
+
+static int toolcache_read(uint32_t flash_addr, void *dst, uint32_t size)
+{
+    if(pi_flash_open(&flash))
+    {
+        return TOOLCACHE_ERR_OPEN;
+    }
+    int err = pi_flash_read(&flash, flash_addr, dst, size);
+    pi_flash_close(&flash);
+    return err ? TOOLCACHE_ERR_READ : TOOLCACHE_OK;
+}
+
+static uint32_t toolcache_hash(const uint32_t *words, uint32_t size)
+{
+    uint32_t h = 0x811c9dc5;
+    for(uint32_t i = 0; i < size / 4; i++)
+    {
+        h = (h ^ words[i]) * 0x01000193;
+    }
+    return h;
+}
+
+// Load an image, the interrupts are left disabled when it succeeds
+static int toolcache_run(uint32_t flash_addr, uint32_t nb_segments, uint32_t hash)
+{
+    toolcache_segment_t *segments = (toolcache_segment_t *) toolcache_buff;
+    uint32_t table_size = nb_segments * sizeof(toolcache_segment_t);
+    if(table_size > TOOLCACHE_BUFF_SIZE)
+    {
+        return TOOLCACHE_ERR_SIZE;
+    }
+    int err = toolcache_read(flash_addr, segments, table_size);
+    if(err != TOOLCACHE_OK)
+    {
+        return err;
+    }
+
+    uint32_t data_size = 0;
+    for(uint32_t i = 0; i < nb_segments; i++)
+    {
+        data_size += (segments[i].filesz + 3) & ~3;
+    }
+    if(table_size + data_size > TOOLCACHE_BUFF_SIZE)
+    {
+        return TOOLCACHE_ERR_SIZE;
+    }
+    err = toolcache_read(flash_addr + table_size, toolcache_buff + table_size, data_size);
+    if(err != TOOLCACHE_OK)
+    {
+        return err;
+    }
+    if(toolcache_hash((uint32_t *) toolcache_buff, table_size + data_size) != hash)
+    {
+        return TOOLCACHE_ERR_HASH;
+    }
+
+    disable_irq();
+    uint8_t *src = toolcache_buff + table_size;
+    for(uint32_t i = 0; i < nb_segments; i++)
+    {
+        memcpy((void *) segments[i].addr, src, segments[i].filesz);
+        memset((void *) (segments[i].addr + segments[i].filesz), 0,
+                segments[i].memsz - segments[i].filesz);
+        src += (segments[i].filesz + 3) & ~3;
+    }
+    return TOOLCACHE_OK;
+}
+
+int main(void)
+{
+    pi_freq_set(PI_FREQ_DOMAIN_FC, 180000000);
+    __rt_debug_struct_ptr = &gap_toolcache;
+
+#if defined(USE_MRAM)
+    struct pi_mram_conf flash_conf;
+    pi_mram_conf_init(&flash_conf);
+#else
+    struct pi_default_flash_conf flash_conf;
+    pi_default_flash_conf_init(&flash_conf);
+#endif
+    pi_open_from_conf(&flash, &flash_conf);
+
+    gap_toolcache.version = toolcache_id.version;
+    gap_toolcache.build_hash = toolcache_id.build_hash;
+    gap_toolcache.buff = (uint32_t) toolcache_buff;
+    gap_toolcache.buff_size = TOOLCACHE_BUFF_SIZE;
+    // published last, the host waits for it
+    *(volatile uint32_t *)&gap_toolcache.magic = toolcache_id.magic;
+
+    volatile toolcache_t *bridge = &gap_toolcache;
+    while(1)
+    {
+        uint32_t cmd = bridge->cmd;
+        if(cmd == TOOLCACHE_CMD_READ)
+        {
+            if(bridge->arg1 > TOOLCACHE_BUFF_SIZE)
+            {
+                bridge->status = TOOLCACHE_ERR_SIZE;
+            }
+            else
+            {
+                bridge->status = toolcache_read(bridge->arg0, toolcache_buff, bridge->arg1);
+            }
+            bridge->cmd = TOOLCACHE_CMD_NONE;
+        }
+        else if(cmd == TOOLCACHE_CMD_RUN)
+        {
+            int status = toolcache_run(bridge->arg0, bridge->arg1, bridge->arg2);
+            bridge->status = status;
+            bridge->cmd = TOOLCACHE_CMD_NONE;
+            if(status == TOOLCACHE_OK)
+            {
+                // the runtime may have been overwritten, wait for the host
+                while(1);
+            }
+        }
+        pi_time_wait_us(1);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Batch inference harness, target side of host/gap9-bench: the application
+# runs the loop of src/bench/gap_bench.h, each input is written to its input
+# buffer with load_image and a run is triggered through the mailbox.
+#
+# mailbox (gap_bench symbol)
+#  ____________________
+# |    Content  | Size |
+# |------0------|------|
+# | MAGIC       | (4)  | "GBCH"
+# |-----+4------|------|
+# | CMD         | (4)  | # 1 run, 2 stop, cleared by the target
+# |-----+8------|------|
+# | SEQ         | (4)  | # runs done
+# |-----+12-----|------|
+# | INPUT       | (4)  |
+# |-----+16-----|------|
+# | INPUT_SIZE  | (4)  |
+# |-----+20-----|------|
+# | PERF        | (4)  | # cycles of each layer
+# |-----+24-----|------|
+# | NB_LAYERS   | (4)  |
+# |-----+28-----|------|
+# | NAMES       | (4)  | # char * of each layer, or 0
+# |-----+32-----|------|
+# | STATUS      | (4)  |
+# |_____________|______|
+
+# Start elf_file, the mailbox is in .bss which load_image does not clear: a
+# magic left by the previous run would be taken for the new one
+proc gap9_bench_start { elf_file pc_entry mb_addr } {
+    targets $::_FC
+    halt
+    mww $mb_addr 0
+    load_and_start_binary $elf_file $pc_entry
+}
+
+# Wait for the application to publish its mailbox, returns
+# {input input_size perf nb_layers names} and the name pointers
+proc gap9_bench_info { mb_addr {timeout_ms 10000} } {
+    set t0 [ms]
+    set magic 0
+    while { ($magic != 0x48434247) && ([ms] - $t0 < $timeout_ms) } {
+        mem2array mb 32 $mb_addr 9
+        set magic $mb(0)
+    }
+    if { $magic != 0x48434247 } {
+        error "the application did not publish its mailbox"
+    }
+    set res [list $mb(3) $mb(4) $mb(5) $mb(6) $mb(7)]
+    if { ($mb(7) != 0) && ($mb(6) > 0) } {
+        mem2array names 32 $mb(7) $mb(6)
+        for {set i 0} {$i < $mb(6)} {incr i} {
+            lappend res $names($i)
+        }
+    }
+    return $res
+}
+
+# One inference on input_file (raw tensor), returns {status run_ms cycles...}
+# with the cycles of each layer
+proc gap9_bench_run { mb_addr input_file {timeout_ms 10000} } {
+    mem2array mb 32 $mb_addr 9
+    set seq $mb(2)
+    load_image $input_file $mb(3) bin
+    mww [expr {$mb_addr + 4}] 1
+    set t0 [ms]
+    while { $mb(2) == $seq } {
+        if { [ms] - $t0 > $timeout_ms } {
+            error "no result after $timeout_ms ms"
+        }
+        mem2array mb 32 $mb_addr 9
+    }
+    set res [list $mb(8) [expr {[ms] - $t0}]]
+    if { ($mb(5) != 0) && ($mb(6) > 0) } {
+        mem2array perf 32 $mb(5) $mb(6)
+        for {set i 0} {$i < $mb(6)} {incr i} {
+            lappend res $perf($i)
+        }
+    }
+    return $res
+}
+
+# Let the application leave its loop
+proc gap9_bench_stop { mb_addr } {
+    mww [expr {$mb_addr + 4}] 2
+}
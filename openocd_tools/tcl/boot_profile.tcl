@@ -0,0 +1,93 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Boot time profiler, see host/gap9-boot-profile and src/boot. Source after
+# gap9revb_boot_profile.tcl, which does not reset the board nor examine the FC.
+#
+# The board is reset with confreg selecting the boot mode, then the host times
+# from the last reset release, as fast as JTAG allows:
+# - the transitions of the confreg status,
+# - the first time the debug module answers (the ROM has enabled JTAG),
+# - the stages of the marker of the application (gap_boot in L2), read through
+#   system bus accesses, the FC is never halted.
+#
+# One line per event, times in microseconds from the reset release:
+# BOOT,<run>,<t_us>,<event>,<value>
+# events: confreg (status), jtag, loaded, start, main, cycles (FC cycles from
+# start to main, from the marker), and a summary of the polling:
+# BOOT_STATS,<run>,<polls>,<elapsed_us>
+
+set gap9_boot_stages {loaded start main}
+
+proc gap9_boot_profile { run confreg marker_addr {timeout_ms 2000} } {
+    targets $::_FC
+    set lines {}
+    set polls 0
+
+    # a marker left in L2 by the previous boot would be seen before the loader
+    # has run, it is cleared when the FC can already be reached
+    if { ![catch {$::_FC arp_examine}] } {
+        catch {mww $marker_addr 0}
+    }
+
+    # the reset sequence of gap9revb_mram_boot.tcl (reset, ABB disabled,
+    # reset), the settle time after the last release is what is measured
+    gap_reset 1
+    disable_abb
+    jtag_reset 1 1
+    sleep $::GAP_RESET_HOLD_MS
+    jtag_reset 0 0
+    set t0 [clock microseconds]
+    set timeout_us [expr {$timeout_ms * 1000}]
+
+    # confreg, back to back until end of boot (some boot modes never set it)
+    set status -1
+    while { 1 } {
+        set ret [confreg_scan $confreg]
+        set t [expr {[clock microseconds] - $t0}]
+        incr polls
+        if { $ret != $status } {
+            lappend lines "BOOT,$run,$t,confreg,$ret"
+            set status $ret
+        }
+        if { ($ret == 0x3) || ($t > $::GAP_CONFREG_NOBLOCK_MS * 1000) } {
+            break
+        }
+    }
+
+    # the debug module answers once the ROM has enabled JTAG
+    while { [catch {$::_FC arp_examine}] } {
+        incr polls
+        if { [clock microseconds] - $t0 > $timeout_us } {
+            lappend lines "BOOT_STATS,$run,$polls,[expr {[clock microseconds] - $t0}]"
+            return [join $lines "\n"]
+        }
+    }
+    lappend lines "BOOT,$run,[expr {[clock microseconds] - $t0}],jtag,0"
+    catch {jtag arp_init}
+
+    # stages of the marker, the first read may already see several of them
+    set stage -1
+    while { [clock microseconds] - $t0 < $timeout_us } {
+        if { [catch {mem2array marker 32 $marker_addr 3}] } {
+            continue
+        }
+        set t [expr {[clock microseconds] - $t0}]
+        incr polls
+        if { $marker(0) != 0x544f4247 } {
+            continue
+        }
+        for {set s [expr {$stage + 1}]} {$s <= $marker(1) && $s < 3} {incr s} {
+            lappend lines "BOOT,$run,$t,[lindex $::gap9_boot_stages $s],$s"
+        }
+        if { $marker(1) > $stage } {
+            set stage $marker(1)
+        }
+        if { $stage >= 2 } {
+            lappend lines "BOOT,$run,$t,cycles,$marker(2)"
+            break
+        }
+    }
+    lappend lines "BOOT_STATS,$run,$polls,[expr {[clock microseconds] - $t0}]"
+    return [join $lines "\n"]
+}
@@ -0,0 +1,47 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Capture of named buffers (tensors) of an application, see host/gap9-capture.
+# Each buffer is read with a single dump_image, at breakpoints and at the end
+# of the application. Needs profile.tcl for gap9_run_stops.
+#
+# buffers are {name addr size} triples, addr being *<addr> when the buffer is
+# at the pointer stored at <addr> (dynamically allocated buffers). One line per
+# buffer and stop, for host/gap9-capture:
+# CAPTURE,<stop>,<label>,<name>,<addr>,<size>,<file>,<ms>
+
+proc gap9_capture_buffers { out_dir buffers stop label } {
+    set lines {}
+    foreach buffer $buffers {
+        set name [lindex $buffer 0]
+        set addr [lindex $buffer 1]
+        set size [lindex $buffer 2]
+        if { [string index $addr 0] eq "*" } {
+            mem2array ptr 32 [string range $addr 1 end] 1
+            set addr $ptr(0)
+        }
+        set file "${stop}_${name}.bin"
+        set t0 [ms]
+        dump_image [file join $out_dir $file] $addr $size
+        lappend lines "CAPTURE,$stop,$label,$name,$addr,$size,$file,[expr {[ms] - $t0}]"
+    }
+    return $lines
+}
+
+# Start elf_file and capture the buffers at each stop (see gap9_run_stops).
+# Without elf_file, the application already running is captured at the
+# breakpoints, or right away if there is none.
+proc gap9_capture_run { out_dir buffers {elf_file ""} {pc_entry 0} {breakpoints {}} {timeout_ms 60000} } {
+    file mkdir $out_dir
+    targets $::_FC
+    halt
+    if { $elf_file ne "" } {
+        load_image $elf_file 0x0 elf
+        reg pc $pc_entry
+    } elseif { [llength $breakpoints] == 0 } {
+        set lines [gap9_capture_buffers $out_dir $buffers 0 now]
+        resume
+        return [join $lines "\n"]
+    }
+    return [join [gap9_run_stops $breakpoints $timeout_ms [list gap9_capture_buffers $out_dir $buffers]] "\n"]
+}
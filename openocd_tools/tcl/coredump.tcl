@@ -0,0 +1,207 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Post-mortem dump of the cores and memories, assembled into an ELF core file by
+# host/gap9-coredump. Attach without reset (gap9revb_no_reset.tcl, with
+# GAP_CLUSTER for the cluster cores) and source profile.tcl and
+# load_incremental.tcl before this script.
+#
+# The memories are first hashed by blocks on the FC with the stub of
+# load_incremental.tcl: the blocks which are all zeroes are not transferred,
+# the others are read with dump_image, by runs as long as possible. The stub
+# uses 4.25 KiB at scratch_addr and the registers of the FC, both are restored
+# before anything is read.
+#
+# out_dir receives the runs of non zero blocks and coredump.txt:
+# REG,<target>,<register>,<value>
+# MEM,<addr>,<size>,<file>
+# ZERO,<addr>,<size>
+
+# registers of a core, in the order of the ELF core notes (pc replaces zero)
+set gap9_coredump_regs {
+    pc ra sp gp tp t0 t1 t2 fp s1 a0 a1 a2 a3 a4 a5 a6 a7
+    s2 s3 s4 s5 s6 s7 s8 s9 s10 s11 t3 t4 t5 t6
+}
+
+# regions dumped by default: {name addr size [raw]}, raw regions (peripherals)
+# are read as they are, never hashed
+set gap9_coredump_regions {
+    {l2 0x1c000000 0x190000}
+    {l1 0x10000000 0x20000}
+}
+
+# hash of a block of zeroes, as computed by the stub
+proc gap9_zero_hash { block_size } {
+    set h 0x811c9dc5
+    for {set i 0} {$i < $block_size / 4} {incr i} {
+        set h [expr {($h * 0x01000193) & 0xffffffff}]
+    }
+    return $h
+}
+
+# registers and csrs of a halted core, as a list of name value
+proc gap9_core_regs { core {csrs {mstatus mepc mcause mtval}} } {
+    targets $core
+    set regs {}
+    foreach name [concat $::gap9_coredump_regs $csrs] {
+        lappend regs $name [gap9_reg $name]
+    }
+    return $regs
+}
+
+# Run script on the FC halted in an application, with the stub of
+# load_incremental.tcl at scratch_addr (none if empty, script runs its own):
+# the registers of the FC, and with save the 4.25 KiB at scratch_addr, are put
+# back afterwards, also when script fails.
+proc gap9_stub_call { scratch_addr script {save 1} } {
+    targets $::_FC
+    foreach {name value} [gap9_core_regs $::_FC {mstatus}] {
+        set regs($name) $value
+    }
+    set scratch_words [expr {(0x100 + 4 * 1024) / 4}]
+    if { ($scratch_addr ne "") && $save } {
+        mem2array scratch 32 $scratch_addr $scratch_words
+    }
+    if { $scratch_addr ne "" } {
+        gap9_stub_write $scratch_addr
+    }
+    set res [catch {uplevel 1 $script} out]
+    targets $::_FC
+    if { $res } {
+        # the stub may not have reached its ebreak
+        halt
+    }
+    if { ($scratch_addr ne "") && $save } {
+        array2mem scratch 32 $scratch_addr $scratch_words
+    }
+    foreach name [concat [lrange $::gap9_coredump_regs 1 end] {pc mstatus}] {
+        reg $name $regs($name)
+    }
+    return -code $res $out
+}
+
+# hashes of the blocks of a region, computed by the FC with the stub already
+# at scratch_addr, fails if the stub cannot run
+proc gap9_coredump_hash { addr nb_blocks block_size scratch_addr } {
+    set results [expr {$scratch_addr + 0x100}]
+    set hashes {}
+    for {set first 0} {$first < $nb_blocks} {incr first 1024} {
+        set nb [expr {($nb_blocks - $first < 1024) ? ($nb_blocks - $first) : 1024}]
+        gap9_stub_run $scratch_addr [expr {$addr + $first * $block_size}] $nb $block_size $results 0
+        mem2array block_hashes 32 $results $nb
+        for {set i 0} {$i < $nb} {incr i} {
+            lappend hashes $block_hashes($i)
+        }
+    }
+    return $hashes
+}
+
+proc gap9_coredump { out_dir {regions ""} {skip_zero 1} {block_size 4096} {scratch_addr 0x1c180000} } {
+    if { $regions eq "" } {
+        set regions $::gap9_coredump_regions
+    }
+    file mkdir $out_dir
+    set manifest [open [file join $out_dir coredump.txt] w]
+    set t0 [ms]
+
+    # stop everything first, then the registers as they were
+    set cores [gap9_profile_targets]
+    foreach core $cores {
+        catch {$core arp_halt}
+    }
+    set halted {}
+    foreach core $cores {
+        if { ![catch {$core arp_waitstate halted 100}] } {
+            lappend halted $core
+            foreach {name value} [gap9_core_regs $core] {
+                puts $manifest "REG,$core,$name,$value"
+                set regs($core,$name) $value
+            }
+        }
+    }
+    targets $::_FC
+
+    # regions which can be accessed: a cluster which is off does not answer
+    set readable {}
+    foreach region $regions {
+        if { [catch {mem2array probe 32 [lindex $region 1] 1}] } {
+            puts "coredump: [lindex $region 0] cannot be accessed, skipped"
+        } else {
+            lappend readable $region
+        }
+    }
+
+    # block hashes of the memories, the FC and the scratch area are restored
+    if { $skip_zero && ([lsearch $halted $::_FC] >= 0) } {
+        gap9_stub_call $scratch_addr {
+            foreach region $readable {
+                if { [lindex $region 3] eq "raw" } {
+                    continue
+                }
+                set nb_blocks [expr {[lindex $region 2] / $block_size}]
+                if { [catch {gap9_coredump_hash [lindex $region 1] $nb_blocks $block_size $scratch_addr} res] } {
+                    puts "coredump: cannot hash [lindex $region 0] ($res), read as a whole"
+                    halt
+                } else {
+                    set hashes([lindex $region 0]) $res
+                }
+            }
+        }
+    }
+    set t1 [ms]
+
+    set read 0
+    set skipped 0
+    set zero [gap9_zero_hash $block_size]
+    foreach region $readable {
+        set name [lindex $region 0]
+        set addr [lindex $region 1]
+        set size [lindex $region 2]
+        if { ![info exists hashes($name)] } {
+            set file "${name}_[format %08x $addr].bin"
+            dump_image [file join $out_dir $file] $addr $size
+            puts $manifest "MEM,$addr,$size,$file"
+            set read [expr {$read + $size}]
+            continue
+        }
+        # runs of blocks of the same kind, the tail of the region is read
+        set kinds {}
+        foreach h $hashes($name) {
+            lappend kinds [expr {$h == $zero}]
+        }
+        set nb_blocks [llength $kinds]
+        if { $nb_blocks * $block_size < $size } {
+            lappend kinds 0
+        }
+        set start 0
+        for {set i 1} {$i <= [llength $kinds]} {incr i} {
+            if { ($i < [llength $kinds]) && ([lindex $kinds $i] == [lindex $kinds $start]) } {
+                continue
+            }
+            set run_addr [expr {$addr + $start * $block_size}]
+            set run_end  [expr {$addr + $i * $block_size}]
+            if { $run_end > $addr + $size } {
+                set run_end [expr {$addr + $size}]
+            }
+            set run_size [expr {$run_end - $run_addr}]
+            if { [lindex $kinds $start] } {
+                puts $manifest "ZERO,$run_addr,$run_size"
+                set skipped [expr {$skipped + $run_size}]
+            } else {
+                set file "${name}_[format %08x $run_addr].bin"
+                dump_image [file join $out_dir $file] $run_addr $run_size
+                puts $manifest "MEM,$run_addr,$run_size,$file"
+                set read [expr {$read + $run_size}]
+            }
+            set start $i
+        }
+    }
+    close $manifest
+    set t2 [ms]
+    set read_ms [expr {($t2 > $t1) ? ($t2 - $t1) : 1}]
+    set summary [format "coredump: %d cores, %d KiB read in %d ms (%d KiB/s), %d KiB of zeroes skipped, %d ms in total" \
+        [llength $halted] [expr {$read / 1024}] $read_ms [expr {$read * 1000 / 1024 / $read_ms}] \
+        [expr {$skipped / 1024}] [expr {$t2 - $t0}]]
+    puts $summary
+    return $summary
+}
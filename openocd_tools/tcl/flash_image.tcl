@@ -21,12 +21,99 @@
 # | FLASH_SIZE  | (4)  |
 # |-----+28-----|------|
 # | FLASH_TYPE  | (4)  |
+# |-----+32-----|------| ---
+# | SECT WRITTEN| (4)  | # gap9 flasher only
+# |-----+36-----|------|
+# | SECT SKIPPED| (4)  |
 # |_____________|______|
 
 # Flash types:
 # HYPERFLASH = 0
 # SPI FLASH  = 1
 
+# Buff Size is published by the gap9 flasher, chunks sent by the host are
+# capped to it. Older flashers leave it to 0 and the host sector_size is used.
+
+# The gap9 flasher exposes this layout as slot 0 of the bridge, and a second
+# slot with the same layout at +40 (dual MRAM + OctoSPI flasher).
+#
+# After the slots, the gap9 flasher publishes its identity and takes requests:
+# +80 MAGIC ("FLSH", set last once the flasher runs), +84 VERSION,
+# +88 BUILD HASH, +92 CTRL (1: reset the protocol state of all the slots,
+# cleared by the flasher once done).
+# Then the settings kept after the flasher speed calibration: +96 FC FREQ,
+# +100 PERIPH FREQ, +104 BAUDRATE slot 0, +108 BAUDRATE slot 1 (read baud rates,
+# 0: SDK default). From version 4, +112 STATUS: 0, or the negative error which
+# stopped the flasher (cleared by a CTRL reset). From version 5, CTRL 2 resets
+# then calibrates the speed on the scratch sectors given at +116 CALIB MRAM ADDR
+# and +120 CALIB OCTOSPI ADDR (0: none, the SDK default settings are kept), a
+# chunk overlapping one of them fails with STATUS -5. From version 6, CTRL 3
+# resets then hashes the device of slot +124 HASH SLOT from +128 HASH ADDR over
+# +132 HASH SIZE bytes, by blocks of +136 HASH BLOCK bytes, to the buffer of the
+# slot (STATUS -6 if the request is invalid or the device cannot be read).
+
+# The flash procs are also run by gap_service.tcl in a long-lived openocd, they
+# raise an error when something fails. Only the gap8 one-shot wrappers
+# (gap_flash_raw*) exit openocd, the scripts running a gap9 flash session end
+# with their own exit.
+
+# the host gives up on a flasher which does not move for that long
+if { ![info exists GAP_FLASHER_TIMEOUT_MS] } {
+    set GAP_FLASHER_TIMEOUT_MS 30000
+}
+
+# Speed calibration of the gap9 flasher, off by default: it writes a test
+# pattern to a scratch sector of each device, which must be reserved for it
+# (8 KiB aligned in MRAM, 4 KiB aligned in OctoSPI flash), e.g.
+# -c "set GAP_FLASHER_CALIB_MRAM 0x1fe000". The flasher then refuses to write
+# there.
+if { ![info exists GAP_FLASHER_CALIB_MRAM] } {
+    set GAP_FLASHER_CALIB_MRAM 0
+}
+if { ![info exists GAP_FLASHER_CALIB_OSPI] } {
+    set GAP_FLASHER_CALIB_OSPI 0
+}
+
+# error published by a gap9 flasher in its bridge, 0 for any other flasher
+proc gap9_flasher_status { bridge } {
+    mem2array id 32 [expr {$bridge + 80}] 2
+    if { ($id(0) != 0x48534c46) || ($id(1) < 4) } {
+        return 0
+    }
+    mem2array status 32 [expr {$bridge + 112}] 1
+    return [expr {$status(0) >= 0x80000000 ? $status(0) - 0x100000000 : $status(0)}]
+}
+
+# raise an error if the flasher failed, or has not moved since t0
+proc gap_flasher_check { bridge t0 } {
+    set status [gap9_flasher_status $bridge]
+    if { $status != 0 } {
+        switch -- $status {
+            -1 { set reason ", verify error" }
+            -3 { set reason ", open error" }
+            -4 { set reason ", out of L2 memory" }
+            -5 { set reason ", chunk overlaps the calibration sector" }
+            -6 { set reason ", device hash failed" }
+            default { set reason "" }
+        }
+        error "flasher failed (status $status$reason)"
+    }
+    if { [ms] - $t0 > $::GAP_FLASHER_TIMEOUT_MS } {
+        error "flasher does not answer after $::GAP_FLASHER_TIMEOUT_MS ms"
+    }
+}
+
+# spin until the flasher sets the word at addr to 1
+proc gap_flasher_wait { addr bridge } {
+    set t0 [ms]
+    mem2array wait1 32 $addr 1
+    while { $wait1(0) != 1 } {
+        gap_flasher_check $bridge $t0
+        sleep 1
+        mem2array wait1 32 $addr 1
+    }
+}
+
 # gap flasher ctrl: load a bin ImageName of size ImageSize to flash at addr 0x0+flash_offset
 proc gap_flasher_ctrl {ImageName ImageSize flash_offset sector_size flash_type device_struct_ptr_addr} {
     # set pointers to right addresses
@@ -39,8 +126,7 @@ proc gap_flasher_ctrl {ImageName ImageSize flash_offset sector_size flash_type d
         set count [expr { $count + 0x1 }]
     }
     if { [expr {$count == 0x80}] } {
-        puts "flasher script could not connect to board, check your cables"
-        exit
+        error "flasher script could not connect to board, check your cables"
     }
     puts "device struct address is [ format 0x%x $device_struct_ptr(0)]"
     set host_rdy        [expr { $device_struct_ptr(0) + 0 } ]
@@ -61,6 +147,11 @@ proc gap_flasher_ctrl {ImageName ImageSize flash_offset sector_size flash_type d
     # HOST RDY <--- 1 / signal to begin app
     mww [expr {$host_rdy}] 0x1
     mem2array buff_ptr 32 $buff_ptr_addr 1
+    mem2array buff_size 32 $buff_size_addr 1
+    if { ($buff_size(0) != 0) && ($sector_size > $buff_size(0)) } {
+        set sector_size [expr {$buff_size(0)}]
+    }
+    # offset in the image file, the flash is written at flash_offset + curr_offset
     set curr_offset [expr {0}]
     puts "going to wait on addr GAP_RDY"
     while { $size > 0 } {
@@ -72,18 +163,14 @@ proc gap_flasher_ctrl {ImageName ImageSize flash_offset sector_size flash_type d
             set size [expr {0}]
         }
         # spin on gap rdy: wait for current flash write to finish
-        mem2array wait1 32 $gap_rdy 1
-        while { [expr { $wait1(0) != 1} ] } {
-            mem2array wait1 32 $gap_rdy 1
-            sleep 1
-        }
+        gap_flasher_wait $gap_rdy $device_struct_ptr(0)
         #puts "wait on gap_rdy done witg buff ptr $buff_ptr"
         mww [expr {$host_rdy}] 0x0
         if { $size == 0 } {
             mww [expr {$flash_run}] 0x0
         }
 
-        mww [expr {$flash_addr}] $curr_offset
+        mww [expr {$flash_addr}] [expr {$flash_offset + $curr_offset}]
         mww [expr {$flash_size}] $curr_size
         # Shift addr to the left, and set the normal base addr as min to throw
         # away bin we already read
@@ -99,17 +186,119 @@ proc gap_flasher_ctrl {ImageName ImageSize flash_offset sector_size flash_type d
         mww [expr {$host_rdy}] 0x1
     }
         # just ensure flasher app does not continue
-    mem2array wait1 32 $flash_run 1
-    while { [expr {$wait1(0) != 1}] } {
-        mem2array wait1 32 $flash_run 1
-        sleep 1
+    gap_flasher_wait $flash_run $device_struct_ptr(0)
+    puts ""
+    if { $buff_size(0) != 0 } {
+        mem2array sectors 32 [expr { $device_struct_ptr(0) + 32 }] 2
+        puts "flasher wrote $sectors(0) sectors, $sectors(1) already up to date"
     }
     puts "flasher is done, exiting"
         mww [expr {$gap_rdy}]   0x0
         mww [expr {$host_rdy}]  0x0
 }
 
-proc gap_flasher_ctrl_VEGA {ImageName ImageSize flash_offset sector_size flash_type device_struct_ptr_addr} {
+# gap flasher ctrl multi: flash several images at once through the flasher
+# slots. Each stream is {ImageName ImageSize flash_offset sector_size slot}.
+# A chunk is sent to a slot as soon as its flasher is ready for it, so that
+# the transfer of one image overlaps the erase/program of the other ones.
+proc gap_flasher_ctrl_multi {streams device_struct_ptr_addr} {
+    set count [expr { 0x0 }]
+    mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+    while { [expr { (($device_struct_ptr(0) == 0xdeadbeef)\
+            || ($device_struct_ptr(0) == 0x0)) && ($count < 0x80) }] } {
+        mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+        sleep 100
+        set count [expr { $count + 0x1 }]
+    }
+    if { [expr {$count == 0x80}] } {
+        error "flasher script could not connect to board, check your cables"
+    }
+    puts "device struct address is [ format 0x%x $device_struct_ptr(0)]"
+    set nb_streams [llength $streams]
+    set pending 0
+    set total_size 0
+    for {set i 0} {$i < $nb_streams} {incr i} {
+        lassign [lindex $streams $i] name($i) size($i) flash_offset($i) sector_size($i) slot
+        set slot_base   [expr { $device_struct_ptr(0) + $slot * 40 }]
+        set host_rdy($i)    [expr { $slot_base + 0 } ]
+        set gap_rdy($i)     [expr { $slot_base + 4 } ]
+        set flash_run($i)   [expr { $slot_base + 16 } ]
+        set flash_addr($i)  [expr { $slot_base + 20 } ]
+        set flash_size($i)  [expr { $slot_base + 24 } ]
+        set curr_offset($i) 0
+        set total_size [expr { $total_size + $size($i) }]
+        if { $size($i) == 0 } {
+            continue
+        }
+        mem2array buff 32 [expr { $slot_base + 8 }] 2
+        set buff_ptr($i) $buff(0)
+        if { ($buff(1) != 0) && ($sector_size($i) > $buff(1)) } {
+            set sector_size($i) [expr {$buff(1)}]
+        }
+        # GAP RDY  <--- 0, then tell the chip we are going to flash
+        mww [expr {$gap_rdy($i)}] 0x0
+        mww [expr {$flash_run($i)}] 0x1
+        mww [expr {$host_rdy($i)}] 0x1
+        incr pending
+    }
+    set left $total_size
+    set t0 [ms]
+    while { $pending > 0 } {
+        set progress 0
+        for {set i 0} {$i < $nb_streams} {incr i} {
+            if { $curr_offset($i) >= $size($i) } {
+                continue
+            }
+            # skip the slot while its flasher is still busy with the previous chunk
+            mem2array wait1 32 $gap_rdy($i) 1
+            if { $wait1(0) != 1 } {
+                continue
+            }
+            set curr_size [expr { $size($i) - $curr_offset($i) }]
+            if { $curr_size > $sector_size($i) } {
+                set curr_size [expr {$sector_size($i)}]
+            }
+            mww [expr {$host_rdy($i)}] 0x0
+            if { $curr_offset($i) + $curr_size == $size($i) } {
+                mww [expr {$flash_run($i)}] 0x0
+                incr pending -1
+            }
+            mww [expr {$flash_addr($i)}] [expr {$flash_offset($i) + $curr_offset($i)}]
+            mww [expr {$flash_size($i)}] $curr_size
+            load_image $name($i) [expr {$buff_ptr($i) - $curr_offset($i)}] bin $buff_ptr($i) $curr_size
+            set curr_offset($i) [expr {$curr_offset($i) + $curr_size}]
+            set left [expr { $left - $curr_size }]
+            puts -nonewline "\rloading images to flash - copied [expr {$total_size - $left}] / $total_size Bytes - [ format %.2f [expr {(($total_size - $left)*100.0)/$total_size} ]] %"
+            # ACK the gap rdy now that we wrote sector (flasher may work)
+            mww [expr {$gap_rdy($i)}] 0x0
+            mww [expr {$host_rdy($i)}] 0x1
+            set progress 1
+        }
+        if { $progress } {
+            set t0 [ms]
+        } else {
+            gap_flasher_check $device_struct_ptr(0) $t0
+            sleep 1
+        }
+    }
+    puts ""
+    # wait for the last chunk of every slot to be written
+    for {set i 0} {$i < $nb_streams} {incr i} {
+        if { $size($i) == 0 } {
+            continue
+        }
+        gap_flasher_wait $flash_run($i) $device_struct_ptr(0)
+        mem2array sectors 32 [expr { $flash_run($i) + 16 }] 2
+        puts "$name($i): flasher wrote $sectors(0) sectors, $sectors(1) already up to date"
+        mww [expr {$gap_rdy($i)}]   0x0
+        mww [expr {$host_rdy($i)}]  0x0
+    }
+    puts "flasher is done, exiting"
+}
+
+# device_struct_addr is the address of the flasher debug_struct, the pointer at
+# device_struct_ptr_addr is not used (see below).
+proc gap_flasher_ctrl_VEGA {ImageName ImageSize flash_offset sector_size flash_type device_struct_ptr_addr {device_struct_addr 0x1c001b10}} {
     # set pointers to right addresses
     #set count [expr 0x0]
     #mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
@@ -124,7 +313,7 @@ proc gap_flasher_ctrl_VEGA {ImageName ImageSize flash_offset sector_size flash_t
     #    exit
     #}
     #DID IT MANUALLY AS NOT SURE WHY I WAS READING A WRONG POINTER
-    set device_struct_ptr(0) [expr {0x1c001b10}]
+    set device_struct_ptr(0) [expr {$device_struct_addr}]
 
     puts "device struct address is $device_struct_ptr(0)"
     set host_rdy        [expr {$device_struct_ptr(0) + 0} ]
@@ -217,7 +406,7 @@ proc gap_flash_raw {image_name image_size gap_tools_path} {
     drscan gap8.cpu 0x4 0x0
     # set reset signals (direct control) jtag_reset 0 1
     jtag_reset 0 0
-    # exit openocd, card will boot from flash
+    # one-shot wrapper: exit openocd, card will boot from flash
     exit
 }
 
@@ -246,26 +435,260 @@ proc gap_flash_raw_hyper {image_name image_size gap_tools_path} {
     drscan gap8.cpu 0x4 0x0
     # set reset signals (direct control) jtag_reset 0 1
     jtag_reset 0 0
-    # exit openocd, card will boot from flash
+    # one-shot wrapper: exit openocd, card will boot from flash
     exit
 
 }
 
+# specific for gap9: check whether a flasher left running by a previous command
+# (e.g. with gap9revb_no_reset.tcl, or in the same openocd session) is the build
+# identified by build_hash (see host/gap9-elf-info --flasher-id). If so, its
+# protocol state is reset and 1 is returned, it is ready for gap_flasher_ctrl.
+# device_struct_addr, when known from the ELF (debug_struct), must match the
+# published bridge pointer.
+proc gap9_flasher_resident {build_hash {device_struct_ptr_addr 0x1c010090} {device_struct_addr 0}} {
+    targets $::_FC
+    if { $build_hash eq "" } {
+        return 0
+    }
+    mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+    set bridge $device_struct_ptr(0)
+    # anything but a pointer to L2 is left over by another application
+    if { ($bridge < 0x1c000000) || ($bridge >= 0x1c200000) } {
+        return 0
+    }
+    if { ($device_struct_addr != 0) && ($bridge != $device_struct_addr) } {
+        return 0
+    }
+    mem2array id 32 [expr {$bridge + 80}] 3
+    if { ($id(0) != 0x48534c46) || ($id(1) != 6) || ($id(2) != [expr {$build_hash}]) } {
+        return 0
+    }
+    if { [$::_FC curstate] eq "halted" } {
+        resume
+    }
+    mww [expr {$bridge + 92}] 0x1
+    set t0 [ms]
+    set ctrl 1
+    while { ($ctrl != 0) && ([ms] - $t0 < 100) } {
+        mem2array ctrl_val 32 [expr {$bridge + 92}] 1
+        set ctrl $ctrl_val(0)
+    }
+    if { $ctrl != 0 } {
+        puts "resident flasher does not answer, loading it again"
+        return 0
+    }
+    return 1
+}
+
+# specific for gap9: have the flasher calibrate its speed on the scratch sectors
+# of GAP_FLASHER_CALIB_MRAM/GAP_FLASHER_CALIB_OSPI, unless it already did with
+# the same ones
+proc gap9_flasher_calibrate {{device_struct_ptr_addr 0x1c010090}} {
+    mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+    set bridge $device_struct_ptr(0)
+    mem2array id 32 [expr {$bridge + 80}] 2
+    if { ($id(0) != 0x48534c46) || ($id(1) < 5) } {
+        return
+    }
+    mem2array calib 32 [expr {$bridge + 116}] 2
+    if { ($calib(0) == [expr {$::GAP_FLASHER_CALIB_MRAM}]) && ($calib(1) == [expr {$::GAP_FLASHER_CALIB_OSPI}]) } {
+        return
+    }
+    mww [expr {$bridge + 116}] $::GAP_FLASHER_CALIB_MRAM
+    mww [expr {$bridge + 120}] $::GAP_FLASHER_CALIB_OSPI
+    mww [expr {$bridge + 92}] 0x2
+    set t0 [ms]
+    set ctrl 2
+    while { $ctrl != 0 } {
+        gap_flasher_check $bridge $t0
+        sleep 1
+        mem2array ctrl_val 32 [expr {$bridge + 92}] 1
+        set ctrl $ctrl_val(0)
+    }
+}
+
+# specific for gap9: hashes of the device of slot (0, or 1 for the OctoSPI flash
+# of the dual flasher) from addr over size bytes, one per block_size bytes, as
+# computed by the flasher in L2 (see gap9_flasher_start): FNV-1a of the 32 bits
+# words, a partial word at the end is padded with zeros (host/gap_elf.py
+# block_hash). Lets the host check a device without reading it over JTAG.
+proc gap9_flasher_hash {slot addr size block_size {device_struct_ptr_addr 0x1c010090}} {
+    mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+    set bridge $device_struct_ptr(0)
+    mem2array id 32 [expr {$bridge + 80}] 2
+    if { ($id(0) != 0x48534c46) || ($id(1) < 6) } {
+        error "the flasher cannot hash the device, it needs the bridge version 6"
+    }
+    mww [expr {$bridge + 124}] $slot
+    mww [expr {$bridge + 128}] $addr
+    mww [expr {$bridge + 132}] $size
+    mww [expr {$bridge + 136}] $block_size
+    mww [expr {$bridge + 92}] 0x3
+    set t0 [ms]
+    set ctrl 3
+    while { $ctrl != 0 } {
+        gap_flasher_check $bridge $t0
+        sleep 1
+        mem2array ctrl_val 32 [expr {$bridge + 92}] 1
+        set ctrl $ctrl_val(0)
+    }
+    gap_flasher_check $bridge $t0
+    set nb [expr {($size + $block_size - 1) / $block_size}]
+    set hashes {}
+    if { $nb > 0 } {
+        mem2array buff 32 [expr {$bridge + 40 * $slot + 8}] 1
+        mem2array words 32 $buff(0) $nb
+        for {set i 0} {$i < $nb} {incr i} {
+            lappend hashes $words($i)
+        }
+    }
+    return $hashes
+}
+
+# specific for gap9: print the frequencies and baud rates the flasher settled on
+proc gap9_flasher_settings {{device_struct_ptr_addr 0x1c010090}} {
+    mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+    set bridge $device_struct_ptr(0)
+    if { ($bridge < 0x1c000000) || ($bridge >= 0x1c200000) } {
+        return
+    }
+    mem2array id 32 [expr {$bridge + 80}] 2
+    if { ($id(0) != 0x48534c46) || ($id(1) < 3) } {
+        return
+    }
+    mem2array settings 32 [expr {$bridge + 96}] 4
+    puts [format "flasher runs at FC %d MHz, periph %d MHz, baud rates %d / %d kHz" \
+        [expr {$settings(0) / 1000000}] [expr {$settings(1) / 1000000}] \
+        [expr {$settings(2) / 1000}] [expr {$settings(3) / 1000}]]
+}
+
+# specific for gap9: load flasher_binary, from the tool cache in flash when
+# toolcache.tcl has it (host/gap9-toolcache), the FC is left halted
+proc gap9_flasher_load {flasher_binary} {
+    targets $::_FC
+    if { ([llength [info procs gap9_toolcache_boot]] == 0) || ![gap9_toolcache_boot ${flasher_binary}] } {
+        halt
+        load_image ${flasher_binary} 0x0 elf
+    }
+}
+
+# specific for gap9: start flasher_binary, unless the same build is still running.
+# flasher_addrs is {pc_entry device_struct_ptr_addr device_struct_addr}, as
+# printed by host/gap9-elf-info --entry --symbol __rt_debug_struct_ptr
+# --symbol debug_struct (0 when unknown). When the bridge address and the build
+# hash are known, the flasher is followed until it is ready instead of waiting
+# for a fixed delay.
+proc gap9_flasher_start {flasher_binary {build_hash ""} {flasher_addrs {0x1c010080 0x1c010090 0}}} {
+    set pc_entry               [lindex $flasher_addrs 0]
+    set device_struct_ptr_addr [lindex $flasher_addrs 1]
+    set device_struct_addr     [lindex $flasher_addrs 2]
+    if { [gap9_flasher_resident $build_hash $device_struct_ptr_addr $device_struct_addr] } {
+        puts "reuse flasher already in L2 memory"
+        gap9_flasher_calibrate $device_struct_ptr_addr
+        return
+    }
+    puts "load flasher to L2 memory"
+    gap9_flasher_load ${flasher_binary}
+    if { ($build_hash eq "") || ($device_struct_addr == 0) } {
+        reg pc ${pc_entry}
+        resume
+        sleep 1000
+        gap9_flasher_calibrate $device_struct_ptr_addr
+        return
+    }
+    # the magic is published last by the flasher, clear what a previous run left
+    mww [expr {$device_struct_addr + 80}] 0x0
+    reg pc ${pc_entry}
+    resume
+    set t0 [ms]
+    set magic 0
+    while { ($magic != 0x48534c46) && ([ms] - $t0 < 2000) } {
+        mem2array magic_val 32 [expr {$device_struct_addr + 80}] 1
+        set magic $magic_val(0)
+    }
+    if { $magic != 0x48534c46 } {
+        error "flasher did not start, check your cables"
+    }
+    set status [gap9_flasher_status $device_struct_addr]
+    if { $status != 0 } {
+        error "flasher failed to start (status $status)"
+    }
+    gap9_flasher_calibrate $device_struct_ptr_addr
+}
+
 # specific for gap9
 # will need to adapt the same way as gap builder to
 # pass all parameters for the name
-proc gap9_flash_raw {image_name image_size flasher_binary sector_size} {
+# flash_offset is the flash address the image is written to: with the MRAM
+# flasher only the 8 KiB sectors it covers are rewritten, the OctoSPI flasher
+# merges the 4 KiB sectors it partly covers: this allows to patch a single
+# partition or blob in place, at any offset.
+# build_hash and flasher_addrs (optional) as for gap9_flasher_start.
+proc gap9_flash_raw {image_name image_size flasher_binary sector_size {flash_offset 0} {build_hash ""} {flasher_addrs {0x1c010080 0x1c010090 0}}} {
     # flash the flasher
     puts "--------------------------"
     puts "begining flash session"
     puts "--------------------------"
-    puts "load flasher to L2 memory"
-    # need to pass board name as arg -- TODO: unify command name
-    load_and_start_binary ${flasher_binary} 0x1c010080
-    sleep 1000
+    gap9_flasher_start ${flasher_binary} ${build_hash} ${flasher_addrs}
+    gap9_flasher_settings [lindex $flasher_addrs 1]
     # flash the flash image with the flasher
     puts "Instruct flasher to begin flash per se"
-    gap_flasher_ctrl $image_name $image_size 0 $sector_size 0 0x1c010090
+    gap_flasher_ctrl $image_name $image_size $flash_offset $sector_size 0 [lindex $flasher_addrs 1]
+    sleep 2
+    puts "--------------------------"
+    puts "flasher is done!"
+    puts "--------------------------"
+}
+
+# specific for gap9: measure the startup latency of flasher binaries, i.e. the
+# JTAG load of the ELF and the time until the flasher publishes GAP RDY.
+# Used to compare the minimal flashers with the regular ones.
+proc gap9_flasher_startup_bench {flasher_binaries {pc_entry 0x1c010080} {device_struct_ptr_addr 0x1c010090}} {
+    targets $::_FC
+    puts [format "%-40s %10s %10s %10s" "flasher" "load (ms)" "init (ms)" "total (ms)"]
+    foreach flasher_binary $flasher_binaries {
+        halt
+        set t0 [ms]
+        load_image ${flasher_binary} 0x0 elf
+        set t1 [ms]
+        # the pointer is published again by the flasher once it runs
+        mww $device_struct_ptr_addr 0x0
+        reg pc ${pc_entry}
+        resume
+        set gap_rdy 0
+        while { ($gap_rdy != 1) && ([ms] - $t1 < 10000) } {
+            mem2array device_struct_ptr 32 $device_struct_ptr_addr 1
+            if { ($device_struct_ptr(0) != 0x0) && ($device_struct_ptr(0) != 0xdeadbeef) } {
+                mem2array wait1 32 [expr {$device_struct_ptr(0) + 4}] 1
+                set gap_rdy $wait1(0)
+            }
+        }
+        set t2 [ms]
+        if { $gap_rdy != 1 } {
+            puts "\[ERR\]: ${flasher_binary} did not get ready"
+            continue
+        }
+        puts [format "%-40s %10d %10d %10d" [file tail $flasher_binary] \
+            [expr {$t1 - $t0}] [expr {$t2 - $t1}] [expr {$t2 - $t0}]]
+    }
+    halt
+}
+
+# specific for gap9: flash an MRAM and an OctoSPI image in the same session with
+# the dual flasher, both devices are programmed concurrently. An image can be
+# skipped by giving it a size of 0. build_hash and flasher_addrs as for
+# gap9_flasher_start.
+proc gap9_flash_raw_dual {mram_image mram_size flash_image flash_size flasher_binary {mram_offset 0} {flash_offset 0} {build_hash ""} {flasher_addrs {0x1c010080 0x1c010090 0}}} {
+    puts "--------------------------"
+    puts "begining flash session (MRAM + OctoSPI)"
+    puts "--------------------------"
+    gap9_flasher_start ${flasher_binary} ${build_hash} ${flasher_addrs}
+    gap9_flasher_settings [lindex $flasher_addrs 1]
+    puts "Instruct flasher to begin flash per se"
+    gap_flasher_ctrl_multi [list \
+        [list $mram_image $mram_size $mram_offset 0x40000 0] \
+        [list $flash_image $flash_size $flash_offset 0x40000 1]] [lindex $flasher_addrs 1]
     sleep 2
     puts "--------------------------"
     puts "flasher is done!"
@@ -320,6 +743,6 @@ proc gap_flash_raw_spi {image_name image_size gap_tools_path} {
     drscan gap8.cpu 0x4 0x0
     # set reset signals (direct control) jtag_reset 0 1
     jtag_reset 0 0
-    # exit openocd, card will boot from flash
+    # one-shot wrapper: exit openocd, card will boot from flash
     exit
 }
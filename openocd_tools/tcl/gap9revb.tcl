@@ -1,5 +1,5 @@
 source [find openocd_tools/tcl/gap9revb_common.tcl]
-adapter_khz     5000
+gap9_adapter_khz 5000
 
 config_reset 0x1
 
@@ -14,27 +14,31 @@ riscv set_command_timeout_sec 1440
 # prefer to use sba for system bus access
 riscv set_prefer_sba on
 
+gap9_expose_perf_csrs
+
 proc jtag_init {} {
     puts "jtag init"
     targets $::_FC
+    gap9_attach_begin
 
-    gap_reset 0 100
-    disable_abb
-    gap_reset 0 100
+    gap9_timed reset { gap_reset 0 }
+    gap9_timed abb_disable { disable_abb }
+    gap9_timed abb_reset { gap_reset 0 }
 
     # wait for jtag ready
-    poll_confreg 0x1
+    gap9_timed confreg { poll_confreg 0x1 }
     echo "INIT: confreg polling done"
 
-    $::_FC arp_examine
+    gap9_timed examine { $::_FC arp_examine }
     echo "examine done"
     jtag arp_init
+    gap9_attach_times
 }
 
 proc init_reset {mode} {
     puts "reseting soc"
     #targets $::_FC
-    gap_reset 1 100
+    gap_reset 1
     # wait for jtag ready
     poll_confreg 0x1
     echo "RESET: confreg polling done"
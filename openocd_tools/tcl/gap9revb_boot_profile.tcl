@@ -0,0 +1,30 @@
+source [find openocd_tools/tcl/gap9revb_common.tcl]
+gap9_adapter_khz 5000
+
+config_reset 0x1
+
+# examined once the ROM has enabled JTAG, by gap9_boot_profile or gap9_boot_image
+target create $_FC riscv -chain-position $_TAP_RISCV -coreid 0x9 -defer-examine
+
+gdb_report_data_abort enable
+gdb_report_register_access_error enable
+
+riscv set_reset_timeout_sec 1440
+riscv set_command_timeout_sec 1440
+
+# prefer to use sba for system bus access: the marker is read without halting
+riscv set_prefer_sba on
+
+# the board is reset by gap9_boot_profile (boot_profile.tcl) or gap9_boot_image, not at init
+proc jtag_init {} {
+    targets $::_FC
+    jtag arp_init
+}
+
+proc init_reset {mode} {
+    jtag arp_init
+}
+
+init
+
+echo "\[OK\]:Ready for Remote Connections"
@@ -21,6 +21,17 @@ set _CL7 $_CHIPNAME.cl7
 set _CL8 $_CHIPNAME.cl8
 set _FC  $_CHIPNAME.fc
 
+# JTAG clock of the gap9 configs: GAP_ADAPTER_KHZ overrides the default of the
+# config, set it before sourcing it (-c "set GAP_ADAPTER_KHZ 15000"). The
+# fastest reliable clock of an adapter is measured by host/gap9-jtag-tune.
+proc gap9_adapter_khz { default_khz } {
+    if { [info exists ::GAP_ADAPTER_KHZ] } {
+        adapter_khz $::GAP_ADAPTER_KHZ
+    } else {
+        adapter_khz $default_khz
+    }
+}
+
 proc config_reset { trst } {
     if { $trst == 1 } {
         reset_config srst_nogate trst_and_srst
@@ -56,6 +67,63 @@ proc examine_cluster {} {
     $::_CL8 arp_examine
 }
 
+# Lazy examination of the cluster cores (-c "set GAP_CLUSTER_LAZY 1" before
+# gap9revb_gdb.tcl): the session is ready as soon as the FC is examined, the
+# cluster cores are examined the first time the cluster is seen powered on. It
+# is checked each time the FC halts and when gdb attaches.
+set GAP_CLUSTER_EXAMINED 0
+
+# The cluster state is read from the SoC control registers, which are always
+# on: an access to the cluster itself while it is off may never complete and
+# hang the interconnect. SOC CTRL + 0x170 holds the cluster reset, released (1)
+# by the runtime once the cluster is powered and clocked, and set back before
+# it is powered off (see cluster_reset below).
+if { ![info exists GAP9_CLUSTER_STATE_REG] } {
+    set GAP9_CLUSTER_STATE_REG 0x1a104170
+}
+if { ![info exists GAP9_CLUSTER_STATE_MASK] } {
+    set GAP9_CLUSTER_STATE_MASK 0x1
+}
+
+proc gap9_cluster_lazy {} {
+    return [expr {[info exists ::GAP_CLUSTER_LAZY] && $::GAP_CLUSTER_LAZY}]
+}
+
+proc gap9_cluster_is_on {} {
+    targets $::_FC
+    if { [catch {mem2array state 32 $::GAP9_CLUSTER_STATE_REG 1}] } {
+        return 0
+    }
+    return [expr {($state(0) & $::GAP9_CLUSTER_STATE_MASK) == $::GAP9_CLUSTER_STATE_MASK}]
+}
+
+# Examine the cluster cores if the cluster is on and they are not examined yet,
+# they are halted with the FC when it is halted. Returns 1 once examined.
+proc gap9_cluster_examine_lazy {} {
+    if { $::GAP_CLUSTER_EXAMINED || ![gap9_cluster_is_on] } {
+        return $::GAP_CLUSTER_EXAMINED
+    }
+    set t0 [ms]
+    if { [catch {examine_cluster} err] } {
+        puts "cluster examine failed: $err"
+        return 0
+    }
+    set ::GAP_CLUSTER_EXAMINED 1
+    if { [$::_FC curstate] eq "halted" } {
+        foreach cl [list $::_CL0 $::_CL1 $::_CL2 $::_CL3 $::_CL4 $::_CL5 $::_CL6 $::_CL7 $::_CL8] {
+            catch {$cl arp_halt}
+        }
+    }
+    targets $::_FC
+    puts "cluster examined in [expr {[ms] - $t0}] ms"
+    return 1
+}
+
+proc gap9_cluster_lazy_events {} {
+    $::_FC configure -event halted { catch {gap9_cluster_examine_lazy} }
+    $::_FC configure -event gdb-attach { catch {gap9_cluster_examine_lazy} }
+}
+
 proc halt_all {} {
     $::_CL0 arp_halt
     $::_CL1 arp_halt
@@ -83,53 +151,156 @@ proc create_smp {} {
     $::_FC configure -rtos hwthread
 }
 
+# Performance counters of the cores (see perf_counters.tcl): PCCR0-15 (0x780),
+# PCER (0xcc0) and PCMR (0xcc1) are custom CSRs, openocd only gives access to
+# them as csr<number> registers once exposed, before init.
+proc gap9_expose_perf_csrs {} {
+    foreach t [target names] {
+        targets $t
+        riscv expose_csrs 1920-1935,3264-3265
+    }
+    targets $::_FC
+}
+
+# Reset and attach timings, they can be overridden like GAP_ADAPTER_KHZ.
+# GAP_RESET_HOLD_MS: reset assertion, GAP_RESET_SETTLE_MS: wait after the
+# release, the chip readiness is then given by confreg, polled without any
+# delay until GAP_CONFREG_TIMEOUT_MS (GAP_CONFREG_NOBLOCK_MS for the boot modes
+# which never set end of boot). The reset times are those of the original
+# sequence, a board known to need less can opt in to shorter ones.
+if { ![info exists GAP_RESET_HOLD_MS] } {
+    set GAP_RESET_HOLD_MS 100
+}
+if { ![info exists GAP_RESET_SETTLE_MS] } {
+    set GAP_RESET_SETTLE_MS 100
+}
+if { ![info exists GAP_CONFREG_TIMEOUT_MS] } {
+    set GAP_CONFREG_TIMEOUT_MS 5000
+}
+if { ![info exists GAP_CONFREG_NOBLOCK_MS] } {
+    set GAP_CONFREG_NOBLOCK_MS 50
+}
+
+# Duration of each stage of the last attach, as a list of {stage ms}
+set GAP_ATTACH_TIMES {}
+
+proc gap9_attach_begin {} {
+    set ::GAP_ATTACH_TIMES {}
+    set ::GAP_ATTACH_T0 [ms]
+}
+
+proc gap9_timed { stage body } {
+    set t0 [ms]
+    uplevel 1 $body
+    lappend ::GAP_ATTACH_TIMES [list $stage [expr {[ms] - $t0}]]
+}
+
+# Print and return the stage timings of the last attach
+proc gap9_attach_times {} {
+    set line "attach timings (ms):"
+    foreach stage $::GAP_ATTACH_TIMES {
+        append line " [lindex $stage 0]=[lindex $stage 1]"
+    }
+    if { [info exists ::GAP_ATTACH_T0] } {
+        append line " total=[expr {[ms] - $::GAP_ATTACH_T0}]"
+    }
+    puts $line
+    return $::GAP_ATTACH_TIMES
+}
+
+# write bootmode value to confreg, returns the status (0x3 once JTAG is usable)
+proc confreg_scan { value } {
+    irscan $::_TAP_PULP 0x6
+    # size then value
+    return [eval drscan $::_TAP_PULP 0x8 $value]
+}
+
 # First set bootmode.
 # Then, poll confreg until end-of-boot (0x3) is set
 proc poll_confreg { value } {
-    irscan $::_TAP_PULP 0x6
-    # size then value
-    set ret [eval drscan $::_TAP_PULP 0x8 $value]
-    puts "ret=$ret"
-    set count [expr { 0x0 }]
-    while { [expr {($ret != 0x3) && ($count < 100)}] } {
-        irscan $::_TAP_PULP 0x6
-        # size then value
-        set ret [eval drscan $::_TAP_PULP 0x8 $value]
-        #puts "ret=$ret"
-        sleep 50
-	set count [expr { $count + 0x1 }]
-    }
-	
-    if { [expr {$count == 100}] } {
-	puts "\[ERR\]:Jtag connect (ret = $ret)"
+    set t0 [ms]
+    set ret [confreg_scan $value]
+    while { ($ret != 0x3) && ([ms] - $t0 < $::GAP_CONFREG_TIMEOUT_MS) } {
+        set ret [confreg_scan $value]
+    }
+    if { $ret != 0x3 } {
+        puts "\[ERR\]:Jtag connect (ret = $ret)"
         exit
     }
-    puts "\[OK\]:Jtag connect"	
+    puts "\[OK\]:Jtag connect"
 }
 
 # First set bootmode.
 # Then, poll confreg only to the point of jtag enable
 # Useful for boot from flash which does not set end of boot (0x3)
 proc poll_confreg_noblock { value } {
-    irscan $::_TAP_PULP 0x6
-    # size then value
-    set ret [eval drscan $::_TAP_PULP 0x8 $value]
+    set t0 [ms]
+    set ret [confreg_scan $value]
+    while { ($ret != 0x3) && ([ms] - $t0 < $::GAP_CONFREG_NOBLOCK_MS) } {
+        set ret [confreg_scan $value]
+    }
     puts "ret=$ret"
-    while { $ret != 0x3 } {
-        irscan $::_TAP_PULP 0x6
-        # size then value
-        set ret [eval drscan $::_TAP_PULP 0x8 $value]
-        puts "ret=$ret"
-        sleep 50
-        set ret 0x3
+}
+
+# confreg value of a boot mode: jtag holds the ROM for an application loaded
+# through JTAG, mram boots the image flashed in MRAM. The value of the boot from
+# the OctoSPI flash depends on the pads of the board, it is given by
+# GAP_BOOT_FLASH_CONFREG. A number is returned as it is.
+proc gap9_boot_confreg { mode } {
+    switch -- $mode {
+        jtag {
+            return 0x1
+        }
+        mram {
+            return 0x7
+        }
+        flash {
+            if { ![info exists ::GAP_BOOT_FLASH_CONFREG] } {
+                error "set GAP_BOOT_FLASH_CONFREG to the confreg value of the flash boot of this board"
+            }
+            return $::GAP_BOOT_FLASH_CONFREG
+        }
+    }
+    if { [string is integer -strict $mode] } {
+        return $mode
     }
+    error "unknown boot mode $mode"
 }
 
-proc gap_reset { trst reset_time } {
+# Reset the board with confreg selecting the boot mode and leave the image
+# flashed for it running, instead of the BOOT1 jumper and the reset button. The
+# reset sequence is the one of gap9revb_mram_boot.tcl. The FC is examined again
+# once the ROM has enabled JTAG, without being halted, so that its memory can
+# still be read (log channel, see rtt.tcl).
+proc gap9_boot_image { mode {timeout_ms 2000} } {
+    set confreg [gap9_boot_confreg $mode]
+    targets $::_FC
+    gap_reset 1
+    disable_abb
+    gap_reset 1
+    poll_confreg_noblock $confreg
+    set t0 [ms]
+    while { [catch {$::_FC arp_examine}] } {
+        if { [ms] - $t0 > $timeout_ms } {
+            error "boot from $mode: JTAG not enabled after $timeout_ms ms"
+        }
+    }
+    catch {jtag arp_init}
+    echo "\[OK\]:Booted from $mode"
+}
+
+# reset_time defaults to GAP_RESET_HOLD_MS, followed by GAP_RESET_SETTLE_MS
+proc gap_reset { trst {reset_time ""} } {
+    if { $reset_time eq "" } {
+        set reset_time $::GAP_RESET_HOLD_MS
+        set settle_time $::GAP_RESET_SETTLE_MS
+    } else {
+        set settle_time $reset_time
+    }
     jtag_reset $trst 1
     sleep $reset_time
     jtag_reset 0 0
-    sleep $reset_time
+    sleep $settle_time
 }
 
 proc disable_abb {} {
@@ -1,5 +1,5 @@
 source [find tcl/gap9revb_common.tcl]
-adapter_khz     5000
+gap9_adapter_khz 5000
 
 config_reset 0x1
 
@@ -24,35 +24,46 @@ riscv set_command_timeout_sec 36000
 # prefer to use sba for system bus access
 riscv set_prefer_sba on
 
+gap9_expose_perf_csrs
+
 proc jtag_init {} {
     puts "jtag init"
     targets $::_FC
+    gap9_attach_begin
 
-    gap_reset 1 100
-    disable_abb
-    gap_reset 1 100
+    gap9_timed reset { gap_reset 1 }
+    gap9_timed abb_disable { disable_abb }
+    gap9_timed abb_reset { gap_reset 1 }
     
     # wait for jtag ready
-    poll_confreg 0xb
+    gap9_timed confreg { poll_confreg 0xb }
     #poll_confreg 0x7
     echo "INIT: confreg polling done"
 
     ## examine_cluster
 
     #$::_CL8 arp_examine
-    examine_cluster
-    $::_FC arp_examine
-    #$::_FC arp_halt
-    halt_all
+    if { [gap9_cluster_lazy] } {
+        # the cluster is off after the reset, examined once it is on
+        gap9_timed examine { $::_FC arp_examine }
+        $::_FC arp_halt
+        gap9_cluster_lazy_events
+    } else {
+        examine_cluster
+        gap9_timed examine { $::_FC arp_examine }
+        #$::_FC arp_halt
+        halt_all
+    }
     $::_FC arm semihosting enable
     echo "INIT: examine done"
     jtag arp_init
+    gap9_attach_times
 }
 
 proc init_reset {mode} {
     puts "hello"
 
-    gap_reset 1 100
+    gap_reset 1
 
     # wait for jtag ready
     poll_confreg 0xb
@@ -68,7 +79,12 @@ init
 
 #targets $::_FC
 #ftdi_set_signal nSRST 1
-halt
+if { [gap9_cluster_lazy] } {
+    # the SMP set has cores which are not examined yet
+    catch {halt}
+} else {
+    halt
+}
 
 #target smp $_FC $_CL8
 #$::_FC arm semihosting enable
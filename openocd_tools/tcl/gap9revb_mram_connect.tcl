@@ -1,5 +1,5 @@
 source [find tcl/gap9revb_common.tcl]
-adapter_khz     5000
+gap9_adapter_khz 5000
 
 config_reset 0x1
 
@@ -17,11 +17,13 @@ riscv set_prefer_sba on
 proc jtag_init {} {
     puts "jtag init"
     targets $::_FC
+    gap9_attach_begin
 
-    poll_confreg_noblock 0x7
-    $::_FC arp_examine
+    gap9_timed confreg { poll_confreg_noblock 0x7 }
+    gap9_timed examine { $::_FC arp_examine }
     echo "examine done"
     jtag arp_init
+    gap9_attach_times
 }
 
 proc init_reset {mode} {
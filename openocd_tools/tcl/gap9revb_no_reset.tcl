@@ -1,10 +1,16 @@
 source [find openocd_tools/tcl/gap9revb_common.tcl]
-adapter_khz     5000
+gap9_adapter_khz 5000
 
 config_reset 0x1
 
 target create $_FC riscv -chain-position $_TAP_RISCV -coreid 0x9 
 
+# -c "set GAP_CLUSTER 1" before this config to attach to the cluster cores as
+# well, when the cluster is on (post-mortem dump of a running application)
+if { [info exists GAP_CLUSTER] && $GAP_CLUSTER } {
+    add_cluster
+}
+
 gdb_report_data_abort enable
 gdb_report_register_access_error enable
 
@@ -17,10 +23,16 @@ riscv set_prefer_sba on
 proc jtag_init {} {
     #puts "jtag init"
     targets $::_FC
-    poll_confreg_noblock 0x7
-    $::_FC arp_examine
+    gap9_attach_begin
+    gap9_timed confreg { poll_confreg_noblock 0x7 }
+    gap9_timed examine { $::_FC arp_examine }
+    if { [info exists ::GAP_CLUSTER] && $::GAP_CLUSTER } {
+        # the cores of a cluster which is off cannot be examined
+        catch {examine_cluster}
+    }
     #echo "examine done"
     jtag arp_init
+    gap9_attach_times
 }
 
 proc init_reset {mode} {
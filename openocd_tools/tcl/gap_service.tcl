@@ -0,0 +1,139 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Service mode: openocd stays attached to the board and runs batches of
+# operations sent over its Tcl RPC port (tcl_port), see host/gap9-service.
+# The attach, and the flasher while it stays in L2, are paid once for all the
+# batches. Source it after the target config and flash_image.tcl.
+#
+# A batch is a Tcl list of operations:
+#   {flash <mram|octospi> <image> [flash_offset]}
+#   {flash_dual <mram_image> <flash_image> [mram_offset] [flash_offset]}
+#   {hash <mram|octospi> <addr> <size> <block_size>} (see gap9_flasher_hash)
+#   {exec <elf> <pc_entry>}
+#   {exec_incremental <elf> <pc_entry> <plan>} (see load_incremental.tcl)
+#   {boot <mram|flash|confreg>} (reset into the flashed image, see gap9_boot_image)
+#   {dump <addr> <size> <file>}
+#   {read <addr> <nb_words>}
+#   {write <addr> <value>}
+#   {attach_times}
+# gap_service_batch returns a JSON array, one object per operation:
+#   {"op": ..., "status": "ok"|"error"|"skipped", "ms": ..., "result": ...}
+# Operations after a failed one are skipped.
+
+# flasher of each device (mram, octospi, dual): {binary build_hash flasher_addrs}
+# as given to gap9_flash_raw
+array set gap_service_flashers {}
+
+proc gap_service_flasher { device binary build_hash flasher_addrs } {
+    set ::gap_service_flashers($device) [list $binary $build_hash $flasher_addrs]
+}
+
+proc gap_service_json_str { str } {
+    return "\"[string map [list \\ \\\\ \" \\\" \n \\n \r \\r \t \\t] $str]\""
+}
+
+proc gap_service_get_flasher { device } {
+    if { ![info exists ::gap_service_flashers($device)] } {
+        error "no flasher configured for $device"
+    }
+    return $::gap_service_flashers($device)
+}
+
+# Run a single operation, returns its JSON result
+proc gap_service_op { op } {
+    set args [lrange $op 1 end]
+    switch -- [lindex $op 0] {
+        flash {
+            set device [lindex $args 0]
+            set image  [lindex $args 1]
+            set offset [expr {[llength $args] > 2 ? [lindex $args 2] : 0}]
+            set size   [file size $image]
+            set flasher [gap_service_get_flasher $device]
+            # same chunks as flash_and_execute.sh
+            set sector_size [expr {$device eq "mram" ? 0x40000 : 0x2000}]
+            gap9_flash_raw $image $size [lindex $flasher 0] $sector_size $offset \
+                [lindex $flasher 1] [lindex $flasher 2]
+            return "{\"device\": [gap_service_json_str $device], \"size\": $size}"
+        }
+        flash_dual {
+            set mram_image  [lindex $args 0]
+            set flash_image [lindex $args 1]
+            set mram_offset  [expr {[llength $args] > 2 ? [lindex $args 2] : 0}]
+            set flash_offset [expr {[llength $args] > 3 ? [lindex $args 3] : 0}]
+            set flasher [gap_service_get_flasher dual]
+            gap9_flash_raw_dual $mram_image [file size $mram_image] \
+                $flash_image [file size $flash_image] [lindex $flasher 0] \
+                $mram_offset $flash_offset [lindex $flasher 1] [lindex $flasher 2]
+            return "{\"mram_size\": [file size $mram_image], \"flash_size\": [file size $flash_image]}"
+        }
+        hash {
+            set flasher [gap_service_get_flasher [lindex $args 0]]
+            gap9_flasher_start [lindex $flasher 0] [lindex $flasher 1] [lindex $flasher 2]
+            set hashes [gap9_flasher_hash 0 [lindex $args 1] [lindex $args 2] [lindex $args 3] \
+                [lindex $flasher 2 1]]
+            return "\[[join $hashes {, }]\]"
+        }
+        exec {
+            load_and_start_binary [lindex $args 0] [lindex $args 1]
+            return "null"
+        }
+        boot {
+            gap9_boot_image [lindex $args 0]
+            return "null"
+        }
+        exec_incremental {
+            gap9_load_incremental [lindex $args 0] [lindex $args 1] [lindex $args 2]
+            return "null"
+        }
+        dump {
+            dump_image [lindex $args 2] [lindex $args 0] [lindex $args 1]
+            return [gap_service_json_str [lindex $args 2]]
+        }
+        read {
+            set nb [lindex $args 1]
+            mem2array words 32 [lindex $args 0] $nb
+            set values {}
+            for {set i 0} {$i < $nb} {incr i} {
+                lappend values $words($i)
+            }
+            return "\[[join $values {, }]\]"
+        }
+        write {
+            mww [lindex $args 0] [lindex $args 1]
+            return "null"
+        }
+        attach_times {
+            set stages {}
+            foreach stage $::GAP_ATTACH_TIMES {
+                lappend stages "[gap_service_json_str [lindex $stage 0]]: [lindex $stage 1]"
+            }
+            return "{[join $stages {, }]}"
+        }
+        default {
+            error "unknown operation [lindex $op 0]"
+        }
+    }
+}
+
+proc gap_service_batch { ops } {
+    set results {}
+    set failed 0
+    foreach op $ops {
+        set name [gap_service_json_str [lindex $op 0]]
+        if { $failed } {
+            lappend results "{\"op\": $name, \"status\": \"skipped\"}"
+            continue
+        }
+        set t0 [ms]
+        if { [catch {gap_service_op $op} res] } {
+            set failed 1
+            lappend results "{\"op\": $name, \"status\": \"error\", \"ms\": [expr {[ms] - $t0}], \"error\": [gap_service_json_str $res]}"
+        } else {
+            lappend results "{\"op\": $name, \"status\": \"ok\", \"ms\": [expr {[ms] - $t0}], \"result\": $res}"
+        }
+    }
+    return "\[[join $results {, }]\]"
+}
+
+echo "\[OK\]:Service ready"
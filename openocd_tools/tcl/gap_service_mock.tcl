@@ -0,0 +1,586 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Stand-in target for the service mode, runs with a plain tclsh instead of
+# openocd and without any board:
+#   tclsh openocd_tools/tcl/gap_service_mock.tcl [port]
+# It provides the openocd commands used by flash_image.tcl and gap_service.tcl
+# on top of a simulated L2 memory, and a simulated flasher which follows the
+# bridge protocol and writes to simulated MRAM/OctoSPI devices. The Tcl RPC
+# protocol of openocd (commands and results terminated by 0x1a) is served on
+# port (6666 by default). The loader of the tool cache (toolcache.tcl) is
+# simulated as well, on top of the simulated devices.
+#
+# mock_flash_dump <mram|octospi> <file> writes the content of a simulated
+# device, to check what a batch has flashed. mock_flasher_fail <status> makes
+# the flasher publish an error on the next chunk. mock_elf_check <elf> checks that
+# the content of the segments of an ELF is in memory, after a full or an
+# incremental load (the block hash stub is simulated).
+
+set mock_dir [file dirname [info script]]
+
+array set mock_mem {}
+array set mock_flash {}
+set mock_flash_size(mram) 0
+set mock_flash_size(octospi) 0
+# flasher simulation
+set mock(loaded) ""
+set mock(running) 0
+set mock(halted) 1
+set mock(bridge) 0
+set mock(slots) {}
+set mock(fail) 0
+# the cluster is off, only the FC is attached
+set mock(cluster) 0
+
+set _FC gap9.fc
+# the simulated devices start empty: a board of its own for the watch cache
+set GAP_ADAPTER_SERIAL mock-[pid]
+set GAP_ATTACH_TIMES {}
+
+proc mock_get { addr } {
+    set addr [expr {$addr & ~3}]
+    if { [info exists ::mock_mem($addr)] } {
+        return $::mock_mem($addr)
+    }
+    return 0
+}
+
+proc mock_set { addr value } {
+    set ::mock_mem([expr {$addr & ~3}]) [expr {$value & 0xffffffff}]
+}
+
+# ---------------------------------------------------------------- flasher
+
+proc mock_flasher_start {} {
+    # identity as configured in the service for this binary, if any
+    set build_hash 0
+    set addrs {0x1c010080 0x1c010090 0}
+    foreach device [array names ::gap_service_flashers] {
+        set cfg $::gap_service_flashers($device)
+        if { [lindex $cfg 0] eq $::mock(loaded) } {
+            set build_hash [expr {[lindex $cfg 1] eq "" ? 0 : [lindex $cfg 1]}]
+            set addrs [lindex $cfg 2]
+        }
+    }
+    set bridge [lindex $addrs 2]
+    if { $bridge == 0 } {
+        set bridge 0x1c018540
+    }
+    set ::mock(bridge) $bridge
+    if { [string match "*dual*" $::mock(loaded)] } {
+        set ::mock(slots) {0 1}
+        set ::mock(device,0) mram
+        set ::mock(device,1) octospi
+        set buff_size 0x20000
+    } elseif { [string match "*mram*" $::mock(loaded)] } {
+        set ::mock(slots) {0}
+        set ::mock(device,0) mram
+        set buff_size 0x40000
+    } else {
+        set ::mock(slots) {0}
+        set ::mock(device,0) octospi
+        set buff_size 0x40000
+    }
+    for {set i 0} {$i < 35} {incr i} {
+        mock_set [expr {$bridge + 4 * $i}] 0
+    }
+    foreach i $::mock(slots) {
+        set slot [expr {$bridge + 40 * $i}]
+        mock_set [expr {$slot + 8}] [expr {0x1c020000 + $i * 0x40000}]
+        mock_set [expr {$slot + 12}] $buff_size
+        mock_set [expr {$slot + 4}] 1
+        set ::mock(state,$i) WAIT_RUN
+        set ::mock(calib,$i) 0
+    }
+    mock_set [lindex $addrs 1] $bridge
+    mock_set [expr {$bridge + 84}] 6
+    mock_set [expr {$bridge + 88}] $build_hash
+    mock_set [expr {$bridge + 96}] 180000000
+    mock_set [expr {$bridge + 100}] 160000000
+    mock_set [expr {$bridge + 80}] 0x48534c46
+    set ::mock(running) 1
+}
+
+proc mock_flasher_write { device addr buff size } {
+    for {set i 0} {$i < $size} {incr i 4} {
+        set ::mock_flash($device,[expr {$addr + $i}]) [mock_get [expr {$buff + $i}]]
+    }
+    if { $addr + $size > $::mock_flash_size($device) } {
+        set ::mock_flash_size($device) [expr {$addr + $size}]
+    }
+}
+
+proc mock_slot_step { i } {
+    set slot [expr {$::mock(bridge) + 40 * $i}]
+    switch -- $::mock(state,$i) {
+        WAIT_RUN {
+            if { [mock_get [expr {$slot + 16}]] } {
+                set ::mock(state,$i) WAIT_HOST
+            }
+        }
+        WAIT_HOST {
+            if { [mock_get $slot] } {
+                mock_set [expr {$slot + 4}] 1
+                set ::mock(state,$i) WAIT_ACK
+            }
+        }
+        WAIT_ACK {
+            set calib $::mock(calib,$i)
+            set calib_size [expr {$::mock(device,$i) eq "mram" ? 0x2000 : 0x1000}]
+            set addr [mock_get [expr {$slot + 20}]]
+            if { ([mock_get [expr {$slot + 4}]] == 0) && $calib && ($addr < $calib + $calib_size)
+                 && ($addr + [mock_get [expr {$slot + 24}]] > $calib) } {
+                mock_set [expr {$::mock(bridge) + 112}] -5
+                set ::mock(state,$i) ERROR
+            } elseif { ([mock_get [expr {$slot + 4}]] == 0) && $::mock(fail) } {
+                mock_set [expr {$::mock(bridge) + 112}] $::mock(fail)
+                set ::mock(fail) 0
+                set ::mock(state,$i) ERROR
+            } elseif { [mock_get [expr {$slot + 4}]] == 0 } {
+                set size [mock_get [expr {$slot + 24}]]
+                mock_flasher_write $::mock(device,$i) [mock_get [expr {$slot + 20}]] \
+                    [mock_get [expr {$slot + 8}]] $size
+                mock_set [expr {$slot + 32}] [expr {[mock_get [expr {$slot + 32}]] + ($size + 8191) / 8192}]
+                if { [mock_get [expr {$slot + 16}]] } {
+                    set ::mock(state,$i) WAIT_HOST
+                } else {
+                    mock_set [expr {$slot + 16}] 1
+                    set ::mock(state,$i) IDLE
+                }
+            }
+        }
+    }
+}
+
+# ---------------------------------------------------------------- tool cache
+
+proc mock_flash_get { device addr } {
+    if { [info exists ::mock_flash($device,$addr)] } {
+        return $::mock_flash($device,$addr)
+    }
+    return 0
+}
+
+proc mock_toolcache_start {} {
+    set bridge [lindex $::gap9_toolcache_loader 2 1]
+    set ::mock(toolcache) $bridge
+    set ::mock(device,0) [expr {[string match "*mram*" $::mock(loaded)] ? "mram" : "octospi"}]
+    foreach {off value} [list 4 2 8 [lindex $::gap9_toolcache_loader 1] 12 0 16 0 28 0x1c170000 32 0x10000 36 0 0 0x4c435447] {
+        mock_set [expr {$bridge + $off}] [expr {$value eq "" ? 0 : $value}]
+    }
+    set ::mock(running) 1
+}
+
+proc mock_toolcache_step {} {
+    set bridge $::mock(toolcache)
+    set cmd [mock_get [expr {$bridge + 12}]]
+    set addr [mock_get [expr {$bridge + 20}]]
+    set arg1 [mock_get [expr {$bridge + 24}]]
+    set device $::mock(device,0)
+    if { $cmd == 1 } {
+        for {set i 0} {$i < $arg1} {incr i 4} {
+            mock_set [expr {0x1c170000 + $i}] [mock_flash_get $device [expr {$addr + $i}]]
+        }
+    } elseif { $cmd == 2 } {
+        # the image is checked before anything is copied
+        set data [expr {$addr + 12 * $arg1}]
+        set end $data
+        for {set s 0} {$s < $arg1} {incr s} {
+            incr end [expr {([mock_flash_get $device [expr {$addr + 12 * $s + 4}]] + 3) & ~3}]
+        }
+        set h 0x811c9dc5
+        for {set a $addr} {$a < $end} {incr a 4} {
+            set h [expr {(($h ^ [mock_flash_get $device $a]) * 0x01000193) & 0xffffffff}]
+        }
+        if { $h != [mock_get [expr {$bridge + 36}]] } {
+            mock_set [expr {$bridge + 16}] -4
+            mock_set [expr {$bridge + 12}] 0
+            return
+        }
+        for {set s 0} {$s < $arg1} {incr s} {
+            set seg_addr [mock_flash_get $device [expr {$addr + 12 * $s}]]
+            set filesz   [mock_flash_get $device [expr {$addr + 12 * $s + 4}]]
+            set memsz    [mock_flash_get $device [expr {$addr + 12 * $s + 8}]]
+            for {set i 0} {$i < $memsz} {incr i 4} {
+                mock_set [expr {$seg_addr + $i}] [expr {$i < $filesz ? [mock_flash_get $device [expr {$data + $i}]] : 0}]
+            }
+            incr data [expr {($filesz + 3) & ~3}]
+        }
+        # the image replaces the loader, as an ELF load would do
+        set ::mock(loaded) ""
+        foreach binary [array names ::gap9_toolcache_images] {
+            if { [lindex $::gap9_toolcache_images($binary) 0] == $addr } {
+                set ::mock(loaded) $binary
+            }
+        }
+        set ::mock(running) 0
+        mock_set 0x1c010090 0xdeadbeef
+        if { $::mock(bridge) != 0 } {
+            mock_set [expr {$::mock(bridge) + 80}] 0
+        }
+    } else {
+        return
+    }
+    mock_set [expr {$bridge + 16}] 1
+    mock_set [expr {$bridge + 12}] 0
+}
+
+# FLASHER_CTRL_HASH, on the simulated device of the slot
+proc mock_flasher_hash {} {
+    set bridge $::mock(bridge)
+    set i [mock_get [expr {$bridge + 124}]]
+    set addr [mock_get [expr {$bridge + 128}]]
+    set size [mock_get [expr {$bridge + 132}]]
+    set block [mock_get [expr {$bridge + 136}]]
+    if { ($i ni $::mock(slots)) || ($block == 0) || ($block & 3) } {
+        mock_set [expr {$bridge + 112}] -6
+        return
+    }
+    set results [mock_get [expr {$bridge + 40 * $i + 8}]]
+    for {set n 0} {$size > 0} {incr n} {
+        set len [expr {min($size, $block)}]
+        set h 0x811c9dc5
+        for {set a 0} {$a < $len} {incr a 4} {
+            set w [mock_flash_get $::mock(device,$i) [expr {$addr + $a}]]
+            if { $len - $a < 4 } {
+                set w [expr {$w & ((1 << (8 * ($len - $a))) - 1)}]
+            }
+            set h [expr {(($h ^ $w) * 0x01000193) & 0xffffffff}]
+        }
+        mock_set [expr {$results + 4 * $n}] $h
+        incr addr $len
+        incr size -$len
+    }
+}
+
+# the flasher moves forward each time the host accesses the target
+proc mock_step {} {
+    if { !$::mock(running) || $::mock(halted) } {
+        return
+    }
+    if { [string match "*gap_toolcache*" $::mock(loaded)] } {
+        mock_toolcache_step
+        return
+    }
+    set ctrl [mock_get [expr {$::mock(bridge) + 92}]]
+    if { ($ctrl == 1) || ($ctrl == 2) || ($ctrl == 3) } {
+        foreach i $::mock(slots) {
+            set slot [expr {$::mock(bridge) + 40 * $i}]
+            foreach off {0 16 32 36} {
+                mock_set [expr {$slot + $off}] 0
+            }
+            mock_set [expr {$slot + 4}] 1
+            set ::mock(state,$i) WAIT_RUN
+        }
+        mock_set [expr {$::mock(bridge) + 112}] 0
+        # calibration always settles on the fastest settings
+        if { $ctrl == 2 } {
+            set calibrated 0
+            foreach i $::mock(slots) {
+                set ::mock(calib,$i) [mock_get [expr {$::mock(bridge) + ($::mock(device,$i) eq "mram" ? 116 : 120)}]]
+                mock_set [expr {$::mock(bridge) + 104 + 4 * $i}] [expr {!$::mock(calib,$i) ? 0 : ($::mock(device,$i) eq "mram" ? 45000000 : 200000000)}]
+                incr calibrated [expr {$::mock(calib,$i) != 0}]
+            }
+            set freq [expr {$calibrated == [llength $::mock(slots)] ? 360000000 : 0}]
+            mock_set [expr {$::mock(bridge) + 96}] [expr {$freq ? $freq : 180000000}]
+            mock_set [expr {$::mock(bridge) + 100}] [expr {$freq ? $freq : 160000000}]
+        }
+        if { $ctrl == 3 } {
+            mock_flasher_hash
+        }
+        mock_set [expr {$::mock(bridge) + 92}] 0
+    }
+    # a failed flasher only answers a reset
+    if { [mock_get [expr {$::mock(bridge) + 112}]] != 0 } {
+        return
+    }
+    foreach i $::mock(slots) {
+        mock_slot_step $i
+    }
+}
+
+# the flasher fails with status on the next chunk (e.g. -1 for a verify error)
+proc mock_flasher_fail { status } {
+    set ::mock(fail) $status
+}
+
+# ---------------------------------------------------------------- openocd
+
+proc echo { msg } { puts $msg }
+proc ms {} { return [clock milliseconds] }
+proc sleep { ms } { mock_step }
+proc targets { args } {}
+proc target { cmd args } {
+    if { $cmd eq "names" } {
+        return [list $::_FC]
+    }
+}
+proc gap9_cluster_is_on {} { return $::mock(cluster) }
+proc adapter_khz { args } {}
+proc halt {} { set ::mock(halted) 1 }
+proc resume {} {
+    set ::mock(halted) 0
+    # the loader of the tool cache starts again from its entry point, even
+    # when none of its blocks had to be loaded
+    if { ($::gap9_toolcache_loader ne "") && ([mock_pc] == [lindex $::gap9_toolcache_loader 2 0]) } {
+        set ::mock(loaded) [lindex $::gap9_toolcache_loader 0]
+        set ::mock(running) 0
+    }
+    if { ($::mock(loaded) ne "") && !$::mock(running) && [string match "*gap_flasher*" $::mock(loaded)] } {
+        mock_flasher_start
+    } elseif { ($::mock(loaded) ne "") && !$::mock(running) && [string match "*gap_toolcache*" $::mock(loaded)] } {
+        mock_toolcache_start
+    }
+}
+proc mock_pc {} {
+    return [expr {[info exists ::mock(reg,pc)] ? $::mock(reg,pc) : 0}]
+}
+# registers are only stored, the core does not execute anything
+proc reg { name {value ""} } {
+    if { $value ne "" } {
+        set ::mock(reg,$name) $value
+    }
+    if { ![info exists ::mock(reg,$name)] } {
+        set ::mock(reg,$name) 0
+    }
+    return [format "%s (/32): 0x%08x" $name $::mock(reg,$name)]
+}
+# only the block hash stub of load_incremental.tcl runs until it halts
+proc wait_halt { args } {
+    set pc [expr {$::mock(reg,pc)}]
+    if { $::mock(halted) || ([mock_get $pc] != [lindex $::gap9_block_hash_stub 0]) } {
+        error "target not halted"
+    }
+    set addr [expr {$::mock(reg,a0)}]
+    set nb_blocks [expr {$::mock(reg,a1)}]
+    set block_size [expr {$::mock(reg,a2)}]
+    set results [expr {$::mock(reg,a3)}]
+    for {set i 0} {$i < $nb_blocks} {incr i} {
+        set h 0x811c9dc5
+        for {set a $addr} {$a < $addr + $block_size} {incr a 4} {
+            if { $::mock(reg,a4) } {
+                mock_set $a 0
+            } else {
+                set h [expr {(($h ^ [mock_get $a]) * 0x01000193) & 0xffffffff}]
+            }
+        }
+        if { !$::mock(reg,a4) } {
+            mock_set [expr {$results + 4 * $i}] $h
+        }
+        incr addr $block_size
+    }
+    set ::mock(halted) 1
+}
+proc gap9.fc { cmd args } {
+    if { $cmd eq "curstate" } {
+        return [expr {$::mock(halted) ? "halted" : "running"}]
+    }
+}
+
+proc mww { addr value } {
+    mock_set $addr $value
+    mock_step
+}
+
+proc mwb { addr value } {
+    set shift [expr {($addr & 3) * 8}]
+    mock_set $addr [expr {([mock_get $addr] & ~(0xff << $shift)) | (($value & 0xff) << $shift)}]
+}
+
+# PT_LOAD segments of an ELF as {paddr filesz offset}, and its content
+proc mock_elf_segments { file data_var } {
+    upvar $data_var data
+    set fd [open $file rb]
+    set data [read $fd]
+    close $fd
+    binary scan $data @28iu phoff
+    binary scan $data @42susu phentsize phnum
+    set segments {}
+    for {set i 0} {$i < $phnum} {incr i} {
+        binary scan $data @[expr {$phoff + $i * $phentsize}]iuiuiuiuiu p_type offset vaddr paddr filesz
+        if { ($p_type == 1) && $filesz } {
+            lappend segments [list $paddr $filesz $offset]
+        }
+    }
+    return $segments
+}
+
+# content of the file segments of the ELF between min and min + len
+proc mock_load_elf { file min len } {
+    foreach seg [mock_elf_segments $file data] {
+        lassign $seg paddr filesz offset
+        set start [expr {max($paddr, $min)}]
+        set end [expr {min($paddr + $filesz, $min + $len)}]
+        if { $start >= $end } {
+            continue
+        }
+        binary scan $data @[expr {$offset + $start - $paddr}]cu[expr {$end - $start}] bytes
+        set a $start
+        foreach b $bytes {
+            mwb $a $b
+            incr a
+        }
+    }
+}
+
+proc mock_elf_check { file } {
+    foreach seg [mock_elf_segments $file data] {
+        lassign $seg paddr filesz offset
+        binary scan $data @${offset}cu$filesz bytes
+        set a $paddr
+        foreach b $bytes {
+            if { (([mock_get $a] >> (($a & 3) * 8)) & 0xff) != $b } {
+                return [format "mismatch at 0x%08x" $a]
+            }
+            incr a
+        }
+    }
+    return ok
+}
+
+# the cluster L1 does not answer while the cluster is off
+proc mock_access { addr } {
+    if { ($addr >= 0x10000000) && ($addr < 0x10400000) && !$::mock(cluster) } {
+        error "Failed to read memory at 0x[format %08x $addr]"
+    }
+}
+
+proc mem2array { var width addr count } {
+    upvar $var words
+    mock_access $addr
+    mock_step
+    for {set i 0} {$i < $count} {incr i} {
+        set words($i) [mock_get [expr {$addr + 4 * $i}]]
+    }
+}
+
+proc array2mem { var width addr count } {
+    upvar $var words
+    mock_access $addr
+    for {set i 0} {$i < $count} {incr i} {
+        mock_set [expr {$addr + 4 * $i}] $words($i)
+    }
+    mock_step
+}
+
+# load_image file addr [bin|elf] [min len]: an ELF replaces whatever runs in L2,
+# the content of the flashers is not simulated
+proc load_image { file addr {type bin} {min 0} {len -1} } {
+    if { $type eq "elf" } {
+        set ::mock(loaded) $file
+        set ::mock(running) 0
+        if { [string match "*gap_flasher*" $file] } {
+            mock_set 0x1c010090 0xdeadbeef
+        } else {
+            mock_load_elf $file $min [expr {$len < 0 ? 0x100000000 : $len}]
+        }
+        if { $::mock(bridge) != 0 } {
+            mock_set [expr {$::mock(bridge) + 80}] 0
+        }
+        return
+    }
+    set fd [open $file rb]
+    set data [read $fd]
+    close $fd
+    if { $len < 0 } {
+        set min $addr
+        set len [string length $data]
+    }
+    mock_access $min
+    set start [expr {$min - $addr}]
+    set bytes [string range $data $start [expr {$start + $len - 1}]]
+    append bytes "\0\0\0"
+    binary scan $bytes i[expr {($len + 3) / 4}] words
+    set a $min
+    foreach w $words {
+        mock_set $a $w
+        incr a 4
+    }
+}
+
+proc dump_image { file addr size } {
+    mock_access $addr
+    set fd [open $file wb]
+    for {set i 0} {$i < $size} {incr i 4} {
+        puts -nonewline $fd [binary format i [mock_get [expr {$addr + $i}]]]
+    }
+    close $fd
+}
+
+proc load_and_start_binary { elf_file pc_entry } {
+    halt
+    load_image $elf_file 0x0 elf
+    reg pc $pc_entry
+    resume
+}
+
+# the board restarts from the flashed image, which is not simulated: the FC
+# simply runs, and the flasher is gone from L2
+proc gap9_boot_image { mode {timeout_ms 2000} } {
+    if { ($mode ni {jtag mram flash}) && ![string is integer -strict $mode] } {
+        error "unknown boot mode $mode"
+    }
+    set ::mock(loaded) ""
+    set ::mock(running) 0
+    if { $::mock(bridge) != 0 } {
+        mock_set [expr {$::mock(bridge) + 80}] 0
+    }
+    set ::mock(halted) 0
+    echo "\[OK\]:Booted from $mode"
+}
+
+proc mock_flash_dump { device file } {
+    set fd [open $file wb]
+    for {set i 0} {$i < $::mock_flash_size($device)} {incr i 4} {
+        set w 0
+        if { [info exists ::mock_flash($device,$i)] } {
+            set w $::mock_flash($device,$i)
+        }
+        puts -nonewline $fd [binary format i $w]
+    }
+    close $fd
+}
+
+proc shutdown {} {
+    exit 0
+}
+
+# ---------------------------------------------------------------- rpc
+
+proc mock_rpc_read { chan } {
+    if { [eof $chan] } {
+        close $chan
+        return
+    }
+    append ::mock_rpc($chan) [read $chan]
+    while { [set end [string first "\x1a" $::mock_rpc($chan)]] >= 0 } {
+        set cmd [string range $::mock_rpc($chan) 0 [expr {$end - 1}]]
+        set ::mock_rpc($chan) [string range $::mock_rpc($chan) [expr {$end + 1}] end]
+        catch {uplevel #0 $cmd} res
+        puts -nonewline $chan "$res\x1a"
+        flush $chan
+    }
+}
+
+proc mock_rpc_accept { chan host port } {
+    set ::mock_rpc($chan) ""
+    fconfigure $chan -translation binary -blocking 0
+    fileevent $chan readable [list mock_rpc_read $chan]
+}
+
+source [file join $mock_dir flash_image.tcl]
+source [file join $mock_dir load_incremental.tcl]
+source [file join $mock_dir rtt.tcl]
+source [file join $mock_dir profile.tcl]
+source [file join $mock_dir coredump.tcl]
+source [file join $mock_dir bench.tcl]
+source [file join $mock_dir capture.tcl]
+source [file join $mock_dir snapshot.tcl]
+source [file join $mock_dir hotpatch.tcl]
+source [file join $mock_dir toolcache.tcl]
+source [file join $mock_dir gap_service.tcl]
+
+set mock_port [expr {$argc > 0 ? [lindex $argv 0] : 6666}]
+socket -server mock_rpc_accept $mock_port
+vwait forever
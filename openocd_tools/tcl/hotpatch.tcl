@@ -0,0 +1,130 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Hot patch of functions of a running application, see host/gap9-hotpatch. The
+# host relocates the new code of the changed functions for a patch area of the
+# application; here, with the cores halted, the patch area is written, the
+# entry of each old function is replaced by a jump to its new code, and the
+# instruction caches are flushed before the application goes on.
+#
+# The patch file starts with fence.i; ebreak, run on the FC with
+# gap9_stub_run to flush its instruction cache. The cluster cache is flushed
+# through its controller when the cluster is on. The code placed by previous
+# runs keeps its place and content in the patch file, a core may still run it:
+# only the bytes from fresh_addr are new, no core may be stopped there.
+#
+# When the cluster is on its cores must be halted as well: attach with
+# GAP_CLUSTER (gap9revb_no_reset.tcl). Needs profile.tcl, load_incremental.tcl
+# and coredump.tcl.
+
+# flush register of the instruction cache controller of the cluster
+set gap9_cluster_icache_flush 0x10201404
+
+# the cores of an SMP set go on together with the first one
+proc gap9_hotpatch_resume { cores } {
+    foreach core $cores {
+        targets $core
+        catch {resume}
+    }
+    targets $::_FC
+}
+
+# Bytes at addr, by words when aligned: the first word of an entry is written
+# last, with a single access
+proc gap9_hotpatch_write { addr bytes } {
+    set len [llength $bytes]
+    if { ($addr & 3) || ($len & 3) } {
+        foreach byte $bytes {
+            mwb $addr $byte
+            incr addr
+        }
+        return
+    }
+    for {set off [expr {$len - 4}]} {$off >= 0} {incr off -4} {
+        lassign [lrange $bytes $off [expr {$off + 3}]] b0 b1 b2 b3
+        mww [expr {$addr + $off}] [expr {$b0 | ($b1 << 8) | ($b2 << 16) | ($b3 << 24)}]
+    }
+}
+
+# patch_file is the content of the patch area from area_addr, new from
+# fresh_addr. redirects are {old_entry new_entry byte...} with the bytes
+# replacing the old entry, restores {addr byte...} to put back the entry of
+# functions patched before and not any more
+proc gap9_hotpatch { patch_file area_addr fresh_addr redirects {restores {}} } {
+    set t0 [ms]
+    set cores [gap9_profile_targets]
+    foreach core $cores {
+        catch {$core arp_halt}
+    }
+    set halted {}
+    foreach core $cores {
+        if { ![catch {$core arp_waitstate halted 100}] } {
+            lappend halted $core
+        }
+    }
+    if { [lsearch $halted $::_FC] < 0 } {
+        gap9_hotpatch_resume $halted
+        error "the FC cannot be halted"
+    }
+    # the cluster cores run the same code, they cannot be left running
+    set cluster_on [gap9_cluster_is_on]
+    if { $cluster_on && (([llength $cores] == 1) || ([llength $halted] < [llength $cores])) } {
+        gap9_hotpatch_resume $halted
+        error "the cluster is on but its cores cannot be halted, attach with GAP_CLUSTER"
+    }
+
+    # a core stopped in the middle of an entry which is replaced cannot go on,
+    # one stopped on an entry goes on in the new code; none may run or return
+    # to code of the patch area which is rewritten
+    set area_end [expr {$area_addr + [file size $patch_file]}]
+    foreach core $halted {
+        targets $core
+        set pc [gap9_reg pc]
+        set ra [gap9_reg ra]
+        if { (($pc >= $fresh_addr) && ($pc < $area_end)) || (($ra >= $fresh_addr) && ($ra < $area_end)) } {
+            gap9_hotpatch_resume $halted
+            error [format "%s runs code of the patch area to rewrite (pc 0x%08x, ra 0x%08x), try again" $core $pc $ra]
+        }
+        foreach redirect $redirects {
+            set entry [lindex $redirect 0]
+            set len [expr {[llength $redirect] - 2}]
+            if { $pc == $entry } {
+                set new_pc($core) [lindex $redirect 1]
+            } elseif { ($pc > $entry) && ($pc < $entry + $len) } {
+                gap9_hotpatch_resume $halted
+                error [format "%s is stopped at 0x%08x, inside an entry to patch, try again" $core $pc]
+            }
+        }
+    }
+
+    targets $::_FC
+    load_image $patch_file $area_addr bin
+    set bytes [expr {[file size $patch_file] - ($fresh_addr - $area_addr)}]
+    foreach redirect $redirects {
+        gap9_hotpatch_write [lindex $redirect 0] [lrange $redirect 2 end]
+    }
+    foreach restore $restores {
+        gap9_hotpatch_write [lindex $restore 0] [lrange $restore 1 end]
+    }
+
+    # fence.i on the FC, its registers are restored afterwards. Without it the
+    # FC may run stale code: the cores are left halted.
+    if { [catch {gap9_stub_call {} {gap9_stub_run $area_addr 0 0 0 0 0}} err] } {
+        error "the FC instruction cache could not be flushed ($err), the cores are left halted, reload"
+    }
+    if { !$cluster_on } {
+        set cluster "cluster off"
+    } else {
+        mww $::gap9_cluster_icache_flush 0xffffffff
+        set cluster "cluster cache flushed"
+    }
+
+    foreach core $halted {
+        if { [info exists new_pc($core)] } {
+            targets $core
+            reg pc $new_pc($core)
+        }
+    }
+    gap9_hotpatch_resume $halted
+    return "hotpatch: [llength $redirects] functions, $bytes new bytes, $cluster, [expr {[ms] - $t0}] ms"
+}
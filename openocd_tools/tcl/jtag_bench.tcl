@@ -0,0 +1,82 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# JTAG link benchmark: SBA block writes and reads of a pseudo random pattern in
+# L2, at increasing adapter speeds and block sizes. Every block is read back and
+# compared word by word to the pattern.
+#
+# One line per measure is printed, for host/gap9-jtag-tune:
+# BENCH,<khz>,<bytes>,<round>,<write kB/s>,<read kB/s>,<bad words>
+# and the selected speed at the end: BENCH_BEST,<khz>
+#
+# The content of L2 at scratch_addr is destroyed, the FC is left halted.
+
+proc gap9_jtag_pattern { var seed nb_words } {
+    upvar $var pattern
+    set value [expr {($seed * 1103515245 + 12345) & 0xffffffff}]
+    for {set i 0} {$i < $nb_words} {incr i} {
+        set value [expr {($value * 1664525 + 1013904223) & 0xffffffff}]
+        set pattern($i) $value
+    }
+}
+
+# Measure one block size at the current speed, returns {write_kBps read_kBps bad_words}
+proc gap9_jtag_bench_block { scratch_addr size seed } {
+    set nb_words [expr {$size / 4}]
+    gap9_jtag_pattern pattern $seed $nb_words
+
+    set t0 [ms]
+    if { [catch {array2mem pattern 32 $scratch_addr $nb_words}] } {
+        return [list 0 0 $nb_words]
+    }
+    set t1 [ms]
+    if { [catch {mem2array readback 32 $scratch_addr $nb_words}] } {
+        return [list 0 0 $nb_words]
+    }
+    set t2 [ms]
+
+    set bad 0
+    for {set i 0} {$i < $nb_words} {incr i} {
+        if { ![info exists readback($i)] || ($readback($i) != $pattern($i)) } {
+            incr bad
+        }
+    }
+    # ms resolution, a block always takes at least 1 ms
+    set write_ms [expr {($t1 - $t0) > 0 ? ($t1 - $t0) : 1}]
+    set read_ms  [expr {($t2 - $t1) > 0 ? ($t2 - $t1) : 1}]
+    return [list [expr {$size / $write_ms}] [expr {$size / $read_ms}] $bad]
+}
+
+# The fastest speed is the one with the best throughput among the speeds
+# without any error: past some point the USB latency dominates and a higher
+# clock does not help. Escalation stops at the first speed with errors.
+proc gap9_jtag_bench { {speeds {5000 10000 15000 20000 25000 30000}} {sizes {1024 16384 65536}} {rounds 3} {scratch_addr 0x1c080000} } {
+    targets $::_FC
+    halt
+    # the first speed is kept when none is reliable, list a known good one first
+    set best_khz  [lindex $speeds 0]
+    set best_rate 0
+    foreach khz $speeds {
+        adapter_khz $khz
+        set rate 0
+        set errors 0
+        foreach size $sizes {
+            for {set r 0} {$r < $rounds} {incr r} {
+                set res [gap9_jtag_bench_block $scratch_addr $size [expr {$khz + $size + $r}]]
+                puts "BENCH,$khz,$size,$r,[lindex $res 0],[lindex $res 1],[lindex $res 2]"
+                set rate   [expr {$rate + [lindex $res 0] + [lindex $res 1]}]
+                set errors [expr {$errors + [lindex $res 2]}]
+            }
+        }
+        if { $errors != 0 } {
+            break
+        }
+        if { $rate > $best_rate } {
+            set best_rate $rate
+            set best_khz  $khz
+        }
+    }
+    adapter_khz $best_khz
+    puts "BENCH_BEST,$best_khz"
+    return $best_khz
+}
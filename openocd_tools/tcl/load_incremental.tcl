@@ -0,0 +1,105 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Incremental ELF load: only the blocks whose content differs from what is
+# already in memory are sent over JTAG. The FC computes the hash of the blocks
+# with a small stub (src/loader/block_hash.S), they are compared to the hashes of
+# the ELF computed by the host (host/gap9-elf-info --load-plan). The .bss is
+# zeroed by the stub as well instead of being transferred.
+
+# src/loader/block_hash.S, assembled for rv32im
+set gap9_block_hash_stub {
+    0x04071063 0x04058a63 0x811ca2b7 0xdc528293 0x01000e37 0x193e0e13
+    0x00c50333 0x00052383 0x0072c2b3 0x03c282b3 0x00450513 0xfe6568e3
+    0x0056a023 0x00468693 0xfff58593 0xfc9ff06f 0x02c58333 0x00650333
+    0x00657863 0x00052023 0x00450513 0xff5ff06f 0x00100073
+}
+
+proc gap9_stub_write { scratch_addr } {
+    set nb_words [llength $::gap9_block_hash_stub]
+    for {set i 0} {$i < $nb_words} {incr i} {
+        set stub($i) [lindex $::gap9_block_hash_stub $i]
+    }
+    array2mem stub 32 $scratch_addr $nb_words
+}
+
+# Run the stub (already in memory at scratch_addr) until its final ebreak
+proc gap9_stub_run { scratch_addr addr nb_blocks block_size results mode } {
+    # no interrupt from the previous application while the stub runs
+    reg mstatus 0x1800
+    reg a0 $addr
+    reg a1 $nb_blocks
+    reg a2 $block_size
+    reg a3 $results
+    reg a4 $mode
+    reg pc $scratch_addr
+    resume
+    wait_halt 1000
+}
+
+# plan is {runs loads fills} as printed by host/gap9-elf-info --load-plan, the
+# stub and its results use scratch_addr (4.25 KiB, must not overlap the ELF).
+# Falls back to a full load if the stub cannot be run.
+proc gap9_load_incremental { elf_file pc_entry plan {scratch_addr 0x1c180000} } {
+    targets $::_FC
+    halt
+    set t0 [ms]
+    set results [expr {$scratch_addr + 0x100}]
+
+    set loaded 0
+    set skipped 0
+    if { [catch {
+        set scratch_end [expr {$scratch_addr + 0x100 + 4 * 1024}]
+        set ranges {}
+        foreach run [lindex $plan 0] {
+            lappend ranges [list [lindex $run 0] [expr {[lindex $run 1] * [lindex $run 2]}]]
+        }
+        foreach range [concat $ranges [lindex $plan 1] [lindex $plan 2]] {
+            set end [expr {[lindex $range 0] + [lindex $range 1]}]
+            if { ([lindex $range 0] < $scratch_end) && ($end > $scratch_addr) } {
+                error "the ELF overlaps the scratch area"
+            }
+        }
+        gap9_stub_write $scratch_addr
+        # .bss first, the content of the segments is never zeroed afterwards
+        foreach fill [lindex $plan 2] {
+            gap9_stub_run $scratch_addr [lindex $fill 0] 1 [lindex $fill 1] $results 1
+        }
+        foreach run [lindex $plan 0] {
+            set addr       [lindex $run 0]
+            set nb_blocks  [lindex $run 1]
+            set block_size [lindex $run 2]
+            set hashes     [lindex $run 3]
+            gap9_stub_run $scratch_addr $addr $nb_blocks $block_size $results 0
+            mem2array target_hashes 32 $results $nb_blocks
+            # contiguous changed blocks are loaded at once
+            set start -1
+            for {set i 0} {$i <= $nb_blocks} {incr i} {
+                set changed [expr {($i < $nb_blocks) && ($target_hashes($i) != [lindex $hashes $i])}]
+                if { $changed && ($start < 0) } {
+                    set start $i
+                } elseif { !$changed && ($start >= 0) } {
+                    load_image $elf_file 0x0 elf [expr {$addr + $start * $block_size}] \
+                        [expr {($i - $start) * $block_size}]
+                    set loaded [expr {$loaded + ($i - $start) * $block_size}]
+                    set start -1
+                }
+                if { ($i < $nb_blocks) && !$changed } {
+                    set skipped [expr {$skipped + $block_size}]
+                }
+            }
+        }
+    } err] } {
+        puts "incremental load failed ($err), full load"
+        halt
+        load_and_start_binary $elf_file $pc_entry
+        return
+    }
+    foreach range [lindex $plan 1] {
+        load_image $elf_file 0x0 elf [lindex $range 0] [lindex $range 1]
+        set loaded [expr {$loaded + [lindex $range 1]}]
+    }
+    puts "incremental load: $loaded bytes loaded, $skipped bytes up to date ([expr {[ms] - $t0}] ms)"
+    reg pc $pc_entry
+    resume
+}
@@ -0,0 +1,118 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Memory diff between two points of an application, see host/gap9-memdiff. At
+# each point the FC hashes the memories by blocks with the stub of
+# load_incremental.tcl, in place of the application: its registers and the
+# blocks under the stub are saved first and restored once the hashes are read,
+# the blocks under the stub are hashed here from the saved copy. Only the
+# hashes, and in a second run the blocks which differ, go through JTAG.
+#
+# Needs profile.tcl, load_incremental.tcl and coredump.tcl. One line per point
+# and region, and per range read:
+# HASH,<point>,<region>,<hash> <hash> ...
+# READ,<point>,<addr>,<size>,<file>
+# TRAFFIC,<point>,<bytes>
+# A region which cannot be accessed (cluster off) has no hash.
+
+# FNV-1a of count words of the array words from first, as the stub computes it
+proc gap9_memdiff_fnv { words_name first count } {
+    upvar $words_name words
+    set h 0x811c9dc5
+    for {set i $first} {$i < $first + $count} {incr i} {
+        set h [expr {(($h ^ $words($i)) * 0x01000193) & 0xffffffff}]
+    }
+    return $h
+}
+
+# Hashes of the regions, {name addr size} aligned on block_size, the FC being
+# halted in the application; returns {lines traffic}
+proc gap9_memdiff_hash { label regions block_size scratch_addr } {
+    targets $::_FC
+    # the blocks under the stub and its results are saved and hashed here
+    set save_addr [expr {$scratch_addr & ~($block_size - 1)}]
+    set save_end  [expr {($scratch_addr + 0x100 + 4 * 1024 + $block_size - 1) & ~($block_size - 1)}]
+    set block_words [expr {$block_size / 4}]
+    set save_words [expr {($save_end - $save_addr) / 4}]
+    mem2array saved 32 $save_addr $save_words
+    for {set a $save_addr} {$a < $save_end} {incr a $block_size} {
+        set saved_hash($a) [gap9_memdiff_fnv saved [expr {($a - $save_addr) / 4}] $block_words]
+    }
+    set traffic [expr {2 * ($save_end - $save_addr) + 4 * [llength $::gap9_block_hash_stub]}]
+
+    set lines {}
+    set res [catch {
+        gap9_stub_call $scratch_addr {
+            foreach region $regions {
+                set name [lindex $region 0]
+                set addr [lindex $region 1]
+                set nb_blocks [expr {[lindex $region 2] / $block_size}]
+                if { [catch {mem2array probe 32 $addr 1}] } {
+                    continue
+                }
+                if { [catch {gap9_coredump_hash $addr $nb_blocks $block_size $scratch_addr} hashes] } {
+                    error "cannot hash $name ($hashes)"
+                }
+                set traffic [expr {$traffic + 4 * $nb_blocks}]
+                for {set a $save_addr} {$a < $save_end} {incr a $block_size} {
+                    set b [expr {($a - $addr) / $block_size}]
+                    if { ($a >= $addr) && ($b < $nb_blocks) } {
+                        set hashes [lreplace $hashes $b $b $saved_hash($a)]
+                    }
+                }
+                lappend lines "HASH,$label,$name,[join $hashes { }]"
+            }
+        } 0
+    } failed]
+    array2mem saved 32 $save_addr $save_words
+    if { $res } {
+        error $failed
+    }
+    return [list $lines $traffic]
+}
+
+# Start elf_file and stop at each of points, {label addr} pairs in the order
+# they are reached, addr being end for the end of the application. At each
+# point the regions are hashed and the ranges of reads, {addr size}, are
+# written to out_dir/<label>_<addr>.bin.
+proc gap9_memdiff_run { out_dir elf_file pc_entry points regions {reads {}} {block_size 1024} {scratch_addr 0x1c180000} {timeout_ms 60000} } {
+    file mkdir $out_dir
+    targets $::_FC
+    halt
+    load_image $elf_file 0x0 elf
+    reg pc $pc_entry
+    set lines {}
+    foreach point $points {
+        set label [lindex $point 0]
+        set addr  [lindex $point 1]
+        targets $::_FC
+        if { $addr ne "end" } {
+            bp $addr 2 hw
+        }
+        resume
+        set res [catch {wait_halt $timeout_ms}]
+        if { $addr ne "end" } {
+            rbp $addr
+        }
+        if { $res || (($addr ne "end") && ([gap9_reg pc] != $addr)) } {
+            halt
+            error "the application did not reach $label"
+        }
+        set hashed [gap9_memdiff_hash $label $regions $block_size $scratch_addr]
+        set lines [concat $lines [lindex $hashed 0]]
+        set traffic [lindex $hashed 1]
+        foreach read $reads {
+            set file [format "%s_%08x.bin" $label [lindex $read 0]]
+            dump_image [file join $out_dir $file] [lindex $read 0] [lindex $read 1]
+            lappend lines "READ,$label,[lindex $read 0],[lindex $read 1],$file"
+            set traffic [expr {$traffic + [lindex $read 1]}]
+        }
+        lappend lines "TRAFFIC,$label,$traffic"
+    }
+    # the application runs on after the last point
+    targets $::_FC
+    if { [lindex [lindex $points end] 1] ne "end" } {
+        resume
+    }
+    return [join $lines "\n"]
+}
@@ -0,0 +1,109 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Performance counters of the FC and cluster cores, programmed and read through
+# the debug module while the cores are halted, see host/gap9-perf. Needs the
+# CSRs exposed by gap9_expose_perf_csrs (gap9revb.tcl, gap9revb_gdb.tcl), and
+# profile.tcl for gap9_reg and gap9_profile_targets.
+#
+# PCER (0xcc0) selects the events, PCMR (0xcc1) enables the counting and
+# PCCR<event> (0x780 + event) holds the count of each event:
+#  0 cycles       active cycles (the core is not sleeping)
+#  1 instr        instructions
+#  2 ld_stall     load data hazards
+#  3 jr_stall     jump register data hazards
+#  4 imiss        instruction cache misses (cycles waiting for the fetch)
+#  5 ld           loads
+#  6 st           stores
+#  7 jump         unconditional jumps
+#  8 branch       branches
+#  9 btaken       taken branches
+# 10 rvc          compressed instructions
+# 11 ld_ext       loads outside the TCDM (cluster)
+# 12 st_ext       stores outside the TCDM (cluster)
+# 13 ld_ext_cyc   cycles of the loads outside the TCDM (cluster)
+# 14 st_ext_cyc   cycles of the stores outside the TCDM (cluster)
+# 15 tcdm_cont    cycles lost to TCDM contention (cluster)
+#
+# The results have one line per core and event, for host/gap9-perf:
+# PERF,<snapshot>,<label>,<target>,<event>,<count>
+# snapshot numbers the stops, a breakpoint can be hit several times.
+
+set gap9_perf_events {
+    cycles instr ld_stall jr_stall imiss ld st jump branch btaken rvc
+    ld_ext st_ext ld_ext_cyc st_ext_cyc tcdm_cont
+}
+
+proc gap9_perf_event_id { event } {
+    set id [lsearch -exact $::gap9_perf_events $event]
+    if { $id < 0 } {
+        error "unknown performance event $event"
+    }
+    return $id
+}
+
+# Reset the counters of a halted core and count events from its next resume
+proc gap9_perf_arm { core events } {
+    targets $core
+    set mask 0
+    reg csr3265 0
+    foreach event $events {
+        set id [gap9_perf_event_id $event]
+        reg csr[expr {1920 + $id}] 0
+        set mask [expr {$mask | (1 << $id)}]
+    }
+    reg csr3264 $mask
+    reg csr3265 1
+}
+
+# Counts of a halted core, arms the counters first if they do not run: a
+# cluster core powered on after the start of the application comes up with
+# its counters off, they count from the first snapshot where it is seen.
+proc gap9_perf_snapshot { snapshot label core events } {
+    targets $core
+    set lines {}
+    if { [gap9_reg csr3265] == 0 } {
+        gap9_perf_arm $core $events
+        set armed 1
+    }
+    foreach event $events {
+        set count [expr {[info exists armed] ? 0 : [gap9_reg csr[expr {1920 + [gap9_perf_event_id $event]}]]}]
+        lappend lines "PERF,$snapshot,$label,$core,$event,$count"
+    }
+    return $lines
+}
+
+# Snapshot of every core which is on (halted with the FC in an SMP set)
+proc gap9_perf_stop { events cores snapshot label } {
+    set lines {}
+    foreach core $cores {
+        if { [catch {$core curstate} state] || ($state ne "halted") } {
+            continue
+        }
+        if { ![catch {gap9_perf_snapshot $snapshot $label $core $events} core_lines] } {
+            set lines [concat $lines $core_lines]
+        }
+    }
+    targets $::_FC
+    return $lines
+}
+
+# Start elf_file with the counters of events armed, and snapshot the counters of
+# every core which is on each time the FC stops on one of the breakpoints,
+# {label addr} pairs, and at the end of the application (see gap9_run_stops).
+proc gap9_perf_run { elf_file pc_entry events {breakpoints {}} {timeout_ms 60000} {cores ""} } {
+    if { $cores eq "" } {
+        set cores [gap9_profile_targets]
+    }
+    targets $::_FC
+    halt
+    load_image $elf_file 0x0 elf
+    reg pc $pc_entry
+    foreach core $cores {
+        if { [catch {$core curstate} state] || ($state ne "halted") } {
+            continue
+        }
+        catch {gap9_perf_arm $core $events}
+    }
+    return [join [gap9_run_stops $breakpoints $timeout_ms [list gap9_perf_stop $events $cores]] "\n"]
+}
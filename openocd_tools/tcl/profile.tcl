@@ -0,0 +1,168 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# PC sampling profiler, see host/gap9-profile. The RISC-V debug module cannot
+# read the pc of a running core, each sample is a short halt: halt, read pc and
+# ra, resume. The time spent halted is measured to report the overhead.
+#
+# The result has one line per sample, for host/gap9-profile:
+# PROF,<time us>,<pc>,<ra>
+# and the statistics at the end:
+# PROF_STATS,<samples>,<elapsed us>,<halted us>
+
+# value of a register of the current target, 0 if it cannot be read
+proc gap9_reg { name } {
+    if { [catch {reg $name} out] || ![regexp {0x[0-9a-fA-F]+} $out value] } {
+        return 0
+    }
+    return $value
+}
+
+# Sample the pc of the target (FC by default) every period_ms (0: back to back)
+# for duration_ms. Stops early if the target halts by itself (end of the
+# application, breakpoint).
+proc gap9_profile { duration_ms {period_ms 1} {target ""} } {
+    if { $target eq "" } {
+        set target $::_FC
+    }
+    targets $target
+    set lines {}
+    set nb 0
+    set halted_us 0
+    set t0 [clock microseconds]
+    set end [expr {$t0 + $duration_ms * 1000}]
+    while { [clock microseconds] < $end } {
+        if { [$target curstate] eq "halted" } {
+            break
+        }
+        set h0 [clock microseconds]
+        $target arp_halt
+        $target arp_waitstate halted 100
+        set pc [gap9_reg pc]
+        set ra [gap9_reg ra]
+        resume
+        set h1 [clock microseconds]
+        set halted_us [expr {$halted_us + $h1 - $h0}]
+        lappend lines "PROF,[expr {$h0 - $t0}],$pc,$ra"
+        incr nb
+        if { $period_ms > 0 } {
+            sleep $period_ms
+        }
+    }
+    lappend lines "PROF_STATS,$nb,[expr {[clock microseconds] - $t0}],$halted_us"
+    return [join $lines "\n"]
+}
+
+# Cores of the SMP set of gap9revb_gdb.tcl which exist in this config, FC first
+proc gap9_profile_targets {} {
+    set cores [list $::_FC]
+    foreach i {0 1 2 3 4 5 6 7 8} {
+        if { [info exists ::_CL$i] && ([lsearch [target names] [set ::_CL$i]] >= 0) } {
+            lappend cores [set ::_CL$i]
+        }
+    }
+    return $cores
+}
+
+# Sample the state and pc of several cores (by default the FC and the cluster
+# cores) every period_ms for duration_ms. The running cores are halted all
+# together for each sample and resumed after (in an SMP set, halting one halts
+# them all anyway). One line per core and sample:
+# CORE,<time us>,<target>,<running|halted|off>,<pc>
+# and the statistics at the end:
+# CORE_STATS,<samples>,<elapsed us>,<halted us>
+# A core is off when it cannot be halted, e.g. the cluster is not powered.
+proc gap9_profile_cores { duration_ms {period_ms 1} {cores ""} } {
+    if { $cores eq "" } {
+        set cores [gap9_profile_targets]
+    }
+    set lines {}
+    set nb 0
+    set halted_us 0
+    set t0 [clock microseconds]
+    set end [expr {$t0 + $duration_ms * 1000}]
+    while { [clock microseconds] < $end } {
+        # the application is over once the FC stops
+        if { [$::_FC curstate] eq "halted" } {
+            break
+        }
+        set h0 [clock microseconds]
+        foreach core $cores {
+            if { [catch {$core curstate} state] || (($state ne "running") && ($state ne "halted")) } {
+                set state off
+            }
+            set states($core) $state
+        }
+        foreach core $cores {
+            if { $states($core) eq "running" } {
+                # may already be halted with the rest of its SMP set
+                catch {$core arp_halt}
+            }
+        }
+        foreach core $cores {
+            set pc 0
+            if { $states($core) ne "off" } {
+                if { [catch {$core arp_waitstate halted 100}] } {
+                    set states($core) off
+                } else {
+                    targets $core
+                    set pc [gap9_reg pc]
+                }
+            }
+            lappend lines "CORE,[expr {$h0 - $t0}],$core,$states($core),$pc"
+        }
+        foreach core $cores {
+            if { $states($core) eq "running" } {
+                targets $core
+                # already resumed with the rest of its SMP set
+                catch {resume}
+            }
+        }
+        targets $::_FC
+        set halted_us [expr {$halted_us + [clock microseconds] - $h0}]
+        incr nb
+        if { $period_ms > 0 } {
+            sleep $period_ms
+        }
+    }
+    lappend lines "CORE_STATS,$nb,[expr {[clock microseconds] - $t0}],$halted_us"
+    return [join $lines "\n"]
+}
+
+# Resume the halted FC until each of the breakpoints, {label addr} pairs, and
+# until the end of the application, and call on_stop with the number and the
+# label of each stop: the label of the breakpoint, "end" when the FC stops
+# anywhere else, or "timeout" (the FC is then halted) if it still runs after
+# timeout_ms. Returns the lists returned by on_stop, concatenated.
+proc gap9_run_stops { breakpoints timeout_ms on_stop } {
+    targets $::_FC
+    foreach bp $breakpoints {
+        bp [lindex $bp 1] 2 hw
+        set labels([expr {[lindex $bp 1]}]) [lindex $bp 0]
+    }
+    set res {}
+    set stop 0
+    set t0 [ms]
+    while { 1 } {
+        targets $::_FC
+        resume
+        set left [expr {$timeout_ms - ([ms] - $t0)}]
+        if { ($left <= 0) || [catch {wait_halt $left}] } {
+            halt
+            set label timeout
+        } else {
+            set pc [expr {[gap9_reg pc]}]
+            set label [expr {[info exists labels($pc)] ? $labels($pc) : "end"}]
+        }
+        set res [concat $res [eval $on_stop [list $stop $label]]]
+        if { ($label eq "end") || ($label eq "timeout") } {
+            break
+        }
+        incr stop
+    }
+    targets $::_FC
+    foreach bp $breakpoints {
+        rbp [lindex $bp 1]
+    }
+    return $res
+}
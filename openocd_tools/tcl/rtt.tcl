@@ -0,0 +1,60 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Drain the log ring buffer of src/rtt/gap_rtt.h while the application runs,
+# through system bus accesses: the core is never halted.
+#
+# control block
+#  ____________________
+# |    Content  | Size |
+# |------0------|------|
+# | MAGIC       | (4)  | "GRTT"
+# |-----+4------|------|
+# | BUFFER      | (4)  |
+# |-----+8------|------|
+# | SIZE        | (4)  |
+# |-----+12-----|------|
+# | WR          | (4)  | # written by the target
+# |-----+16-----|------|
+# | RD          | (4)  | # written by the host
+# |-----+20-----|------|
+# | MODE        | (4)  |
+# |-----+24-----|------|
+# | DROPPED     | (4)  |
+# |_____________|______|
+
+# Read what the target wrote since the last call, at most max_bytes and up to
+# the end of the buffer (the rest comes with the next call). Returns
+# {dropped offset nb_bytes word...}: nb_bytes bytes starting at byte offset of
+# the words (little endian). Returns an empty list if there is no log channel.
+proc gap9_rtt_read { cb_addr {max_bytes 16384} } {
+    mem2array cb 32 $cb_addr 7
+    if { $cb(0) != 0x54545247 } {
+        return {}
+    }
+    set buffer $cb(1)
+    set size   $cb(2)
+    set wr     $cb(3)
+    set rd     $cb(4)
+    if { ($wr >= $size) || ($rd >= $size) } {
+        return {}
+    }
+    if { $wr == $rd } {
+        return [list $cb(6) 0 0]
+    }
+    set len [expr {($wr > $rd) ? ($wr - $rd) : ($size - $rd)}]
+    if { $len > $max_bytes } {
+        set len $max_bytes
+    }
+    set start    [expr {$buffer + $rd}]
+    set aligned  [expr {$start & ~3}]
+    set offset   [expr {$start - $aligned}]
+    set nb_words [expr {($offset + $len + 3) / 4}]
+    mem2array data 32 $aligned $nb_words
+    mww [expr {$cb_addr + 16}] [expr {($rd + $len) % $size}]
+    set res [list $cb(6) $offset $len]
+    for {set i 0} {$i < $nb_words} {incr i} {
+        lappend res $data($i)
+    }
+    return $res
+}
@@ -0,0 +1,171 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Warm start, see host/gap9-snapshot: the memories and the FC registers are
+# saved once the application reaches a marker after its initialisation, later
+# runs restore them and resume from the marker instead of loading the ELF and
+# running the initialisation again. Only the blocks which differ from the
+# snapshot are written, the FC hashes the memories with the stub of
+# load_incremental.tcl before and after to check them.
+#
+# The peripherals are not part of the snapshot: the board must not have been
+# reset since the application ran its initialisation (service mode), and the
+# application must not shut down at its end what it set up before the marker.
+#
+# Needs profile.tcl, load_incremental.tcl and coredump.tcl.
+#
+# out_dir receives snapshot.txt:
+# REG,<register>,<value>
+# MEM,<name>,<addr>,<size>,<file>
+
+set gap9_snapshot_csrs {mstatus mtvec mie mscratch mepc mcause}
+
+# The cluster L1 cannot be accessed while the cluster is off: fail before
+# anything is written rather than in the middle of a restore. regions have
+# their address second.
+proc gap9_snapshot_check_l1 { regions } {
+    foreach region $regions {
+        set addr [lindex $region 1]
+        if { ($addr >= 0x10000000) && ($addr < 0x10400000) && ![gap9_cluster_is_on] } {
+            error "the cluster is off, its L1 cannot be accessed: power it on or snapshot without --l1"
+        }
+    }
+}
+
+# Start elf_file, run it until marker_addr and save the regions there, then let
+# it run on
+proc gap9_snapshot_take { out_dir elf_file pc_entry marker_addr {regions ""} {timeout_ms 60000} } {
+    if { $regions eq "" } {
+        set regions [list [lindex $::gap9_coredump_regions 0]]
+    }
+    file mkdir $out_dir
+    targets $::_FC
+    halt
+    load_image $elf_file 0x0 elf
+    reg pc $pc_entry
+    bp $marker_addr 2 hw
+    resume
+    set res [catch {wait_halt $timeout_ms}]
+    rbp $marker_addr
+    if { $res || ([gap9_reg pc] != $marker_addr) } {
+        halt
+        error "the application did not reach the marker"
+    }
+    if { [catch {gap9_snapshot_check_l1 $regions} err] } {
+        resume
+        error $err
+    }
+
+    set t0 [ms]
+    set manifest [open [file join $out_dir snapshot.txt] w]
+    foreach {name value} [gap9_core_regs $::_FC $::gap9_snapshot_csrs] {
+        puts $manifest "REG,$name,$value"
+    }
+    set size 0
+    foreach region $regions {
+        set file "[lindex $region 0].bin"
+        dump_image [file join $out_dir $file] [lindex $region 1] [lindex $region 2]
+        puts $manifest "MEM,[lindex $region 0],[lindex $region 1],[lindex $region 2],$file"
+        set size [expr {$size + [lindex $region 2]}]
+    }
+    close $manifest
+    targets $::_FC
+    resume
+    return "snapshot: [expr {$size / 1024}] KiB saved in [expr {[ms] - $t0}] ms"
+}
+
+# blocks of a region whose hash differs from hashes, as {first count} runs
+proc gap9_snapshot_diff { target_hashes hashes } {
+    set runs {}
+    set start -1
+    set nb [llength $hashes]
+    for {set i 0} {$i <= $nb} {incr i} {
+        set changed [expr {($i < $nb) && ([lindex $target_hashes $i] != [lindex $hashes $i])}]
+        if { $changed && ($start < 0) } {
+            set start $i
+        } elseif { !$changed && ($start >= 0) } {
+            lappend runs [list $start [expr {$i - $start}]]
+            set start -1
+        }
+    }
+    return $runs
+}
+
+# block hashes of each region, the stub being at scratch_addr; an empty list
+# when the region cannot be hashed (cluster off)
+proc gap9_snapshot_hash { regions block_size scratch_addr } {
+    set res {}
+    foreach region $regions {
+        if { [catch {gap9_coredump_hash [lindex $region 1] [llength [lindex $region 3]] $block_size $scratch_addr} hashes] } {
+            halt
+            set hashes {}
+        }
+        lappend res $hashes
+    }
+    return $res
+}
+
+# Restore a snapshot and resume from its marker. regions are
+# {file addr size hashes} with the hashes of the blocks of the snapshot, regs
+# the name value pairs of the FC registers.
+proc gap9_snapshot_restore { regions regs {block_size 1024} {scratch_addr 0x1c180000} } {
+    set t0 [ms]
+    targets $::_FC
+    halt
+    gap9_snapshot_check_l1 $regions
+    set scratch_end [expr {$scratch_addr + 0x100 + 4 * 1024}]
+
+    # all the regions are hashed before the first write, which may hit the stub;
+    # the scratch area is restored from the snapshot
+    set target_hashes [gap9_stub_call $scratch_addr {gap9_snapshot_hash $regions $block_size $scratch_addr} 0]
+    set written 0
+    set total 0
+    foreach region $regions region_hashes $target_hashes {
+        set file   [lindex $region 0]
+        set addr   [lindex $region 1]
+        set size   [lindex $region 2]
+        set hashes [lindex $region 3]
+        foreach run [gap9_snapshot_diff $region_hashes $hashes] {
+            set start [expr {$addr + [lindex $run 0] * $block_size}]
+            set len   [expr {[lindex $run 1] * $block_size}]
+            load_image $file $addr bin $start $len
+            set written [expr {$written + $len}]
+        }
+        # the tail which is not a whole block
+        set tail [expr {$addr + [llength $hashes] * $block_size}]
+        if { $tail < $addr + $size } {
+            load_image $file $addr bin $tail [expr {$addr + $size - $tail}]
+            set written [expr {$written + $addr + $size - $tail}]
+        }
+        set total [expr {$total + $size}]
+    }
+
+    # check: only the blocks of the scratch area, where the stub runs again,
+    # may differ, they are restored last
+    set target_hashes [gap9_stub_call $scratch_addr {gap9_snapshot_hash $regions $block_size $scratch_addr} 0]
+    foreach region $regions region_hashes $target_hashes {
+        set file   [lindex $region 0]
+        set addr   [lindex $region 1]
+        set size   [lindex $region 2]
+        if { [llength $region_hashes] != 0 } {
+            set scratch_first [expr {($scratch_addr - $addr) / $block_size}]
+            set scratch_last  [expr {($scratch_end - 1 - $addr) / $block_size}]
+            foreach run [gap9_snapshot_diff $region_hashes [lindex $region 3]] {
+                set first [lindex $run 0]
+                set last  [expr {$first + [lindex $run 1] - 1}]
+                if { ($first < $scratch_first) || ($last > $scratch_last) } {
+                    error [format "restore failed, block at 0x%08x differs" [expr {$addr + $first * $block_size}]]
+                }
+            }
+        }
+        if { ($scratch_addr < $addr + $size) && ($scratch_end > $addr) } {
+            load_image $file $addr bin $scratch_addr [expr {$scratch_end - $scratch_addr}]
+        }
+    }
+
+    foreach {name value} $regs {
+        reg $name $value
+    }
+    resume
+    return "restore: [expr {$written / 1024}] KiB written, [expr {($total - $written) / 1024}] KiB up to date, [expr {[ms] - $t0}] ms"
+}
@@ -0,0 +1,174 @@
+# LICENCE: GPLv2 (see COPYING)
+# Copyright Greenwaves Technologies 2024
+
+# Tool cache: the flasher and the other tool ELFs are stored once in a reserved
+# region of the OctoSPI flash (or of the MRAM), and copied to L2 by the loader
+# of src/toolcache at the speed of the flash instead of being pushed over JTAG.
+# The region is written and its index read by host/gap9-toolcache, which
+# registers here the loader and the images found in the cache. Source it after
+# flash_image.tcl and load_incremental.tcl: gap9_flasher_start then takes a
+# registered flasher from the cache, and falls back to a JTAG load if anything
+# goes wrong.
+#
+# The loader stays in the upper L2 while the tools run. It is identified by its
+# bridge and by the hash of its blocks, never by __rt_debug_struct_ptr which
+# every application overwrites: when its code is still in L2, only the blocks
+# which changed (its data, its runtime in the lower L2) are sent over JTAG
+# before it is restarted.
+#
+# loader bridge (gap_toolcache)
+#  ____________________
+# |    Content  | Size |
+# |------0------|------|
+# | MAGIC       | (4)  | "GTCL", published last
+# |-----+4------|------|
+# | VERSION     | (4)  |
+# |-----+8------|------|
+# | BUILD_HASH  | (4)  |
+# |-----+12-----|------|
+# | CMD         | (4)  | # written by the host, cleared when done
+# |-----+16-----|------|
+# | STATUS      | (4)  | # 1 or a negative error
+# |-----+20-----|------|
+# | ARG0        | (4)  | # flash address
+# |-----+24-----|------|
+# | ARG1        | (4)  | # size (READ) or number of segments (RUN)
+# |-----+28-----|------|
+# | BUFF        | (4)  |
+# |-----+32-----|------|
+# | BUFF_SIZE   | (4)  |
+# |-----+36-----|------|
+# | ARG2        | (4)  | # hash of the image (RUN), see gap9_toolcache_image
+# |_____________|______|
+#
+# RUN fails (status -4) without touching the memory when the image read from
+# the flash does not have the hash given by the host.
+
+set gap9_toolcache_loader {}
+array set gap9_toolcache_images {}
+
+# From the loader ELF: loader_addrs is {pc_entry bridge_addr}, code is the
+# {start end} range of its code segment, plan its incremental load plan
+# (host/gap9-elf-info --load-plan) and scratch_addr 4.25 KiB of L2 outside of
+# the loader, for the block hash stub (see gap9_load_incremental).
+proc gap9_toolcache_config { loader_binary build_hash loader_addrs code plan scratch_addr } {
+    set ::gap9_toolcache_loader [list $loader_binary $build_hash $loader_addrs $code $plan $scratch_addr]
+}
+
+# binary is found in the cache at flash_addr, as an image of nb_segments
+# whose hash is the FNV-1a of its 32 bits words (host/gap_elf.py block_hash)
+proc gap9_toolcache_image { binary flash_addr nb_segments hash } {
+    set ::gap9_toolcache_images($binary) [list $flash_addr $nb_segments $hash]
+}
+
+# Start the loader, unless the same build already waits for commands. Returns
+# the address of its bridge.
+proc gap9_toolcache_start {} {
+    if { $::gap9_toolcache_loader eq "" } {
+        error "no tool cache loader configured"
+    }
+    lassign $::gap9_toolcache_loader binary build_hash addrs code plan scratch_addr
+    set pc_entry [lindex $addrs 0]
+    set bridge   [lindex $addrs 1]
+    targets $::_FC
+    halt
+    # still waiting for commands: the FC runs the code of the loader and the
+    # bridge shows this build, idle
+    mem2array id 32 $bridge 4
+    if { ![regexp {0x[0-9a-fA-F]+} [reg pc] pc] } {
+        set pc 0
+    }
+    if { ($pc >= [lindex $code 0]) && ($pc < [lindex $code 1]) && ($id(0) == 0x4c435447)
+         && ($id(1) == 2) && ($id(2) == [expr {$build_hash}]) && ($id(3) == 0) } {
+        resume
+        return $bridge
+    }
+    # the blocks of the loader still in L2 are kept, its .bss is zeroed, then
+    # it starts again from its entry point. The magic is published last.
+    mww $bridge 0x0
+    gap9_load_incremental $binary $pc_entry $plan $scratch_addr
+    set t0 [ms]
+    set magic 0
+    while { ($magic != 0x4c435447) && ([ms] - $t0 < 2000) } {
+        mem2array magic_val 32 $bridge 1
+        set magic $magic_val(0)
+    }
+    if { $magic != 0x4c435447 } {
+        error "tool cache loader did not start"
+    }
+    return $bridge
+}
+
+proc gap9_toolcache_cmd { bridge cmd arg0 arg1 {arg2 0} {timeout_ms 2000} } {
+    mww [expr {$bridge + 20}] $arg0
+    mww [expr {$bridge + 24}] $arg1
+    mww [expr {$bridge + 36}] $arg2
+    mww [expr {$bridge + 16}] 0
+    mww [expr {$bridge + 12}] $cmd
+    set t0 [ms]
+    set pending $cmd
+    while { $pending != 0 } {
+        if { [ms] - $t0 > $timeout_ms } {
+            error "tool cache loader does not answer"
+        }
+        mem2array pending_val 32 [expr {$bridge + 12}] 1
+        set pending $pending_val(0)
+    }
+    mem2array status 32 [expr {$bridge + 16}] 1
+    if { $status(0) == 0xfffffffc } {
+        error "the image in the tool cache is corrupted, store it again"
+    } elseif { $status(0) != 1 } {
+        error "tool cache loader error [expr {$status(0) >= 0x80000000 ? $status(0) - 0x100000000 : $status(0)}]"
+    }
+}
+
+# Content of the flash, as a list of words (size multiple of 4)
+proc gap9_toolcache_read { flash_addr size } {
+    set bridge [gap9_toolcache_start]
+    mem2array buff 32 [expr {$bridge + 28}] 2
+    set words {}
+    for {set done 0} {$done < $size} {incr done $buff(1)} {
+        set nb [expr {($size - $done < $buff(1)) ? ($size - $done) : $buff(1)}]
+        gap9_toolcache_cmd $bridge 1 [expr {$flash_addr + $done}] $nb
+        mem2array data 32 $buff(0) [expr {$nb / 4}]
+        for {set i 0} {$i < $nb / 4} {incr i} {
+            lappend words $data($i)
+        }
+    }
+    return $words
+}
+
+# Copy the image at flash_addr to its load addresses once checked against
+# hash, the FC is left halted: the caller starts it at its entry point
+proc gap9_toolcache_load { flash_addr nb_segments hash } {
+    set bridge [gap9_toolcache_start]
+    gap9_toolcache_cmd $bridge 2 $flash_addr $nb_segments $hash
+    halt
+    # the loader only waits for the halt, its code stays in the upper L2 for
+    # the next start but its runtime is gone once the image runs
+    mww $bridge 0x0
+}
+
+proc gap9_toolcache_run { flash_addr nb_segments hash pc_entry } {
+    set t0 [ms]
+    gap9_toolcache_load $flash_addr $nb_segments $hash
+    reg pc $pc_entry
+    resume
+    return [expr {[ms] - $t0}]
+}
+
+# Load binary from the cache if it is registered, for gap9_flasher_start.
+# Returns 1 with the image in L2 and the FC halted, 0 if it must be loaded
+# over JTAG.
+proc gap9_toolcache_boot { binary } {
+    if { ($::gap9_toolcache_loader eq "") || ![info exists ::gap9_toolcache_images($binary)] } {
+        return 0
+    }
+    set t0 [ms]
+    if { [catch {gap9_toolcache_load {*}$::gap9_toolcache_images($binary)} res] } {
+        puts "tool cache: $res, loading [file tail $binary] over JTAG"
+        return 0
+    }
+    puts "tool cache: [file tail $binary] loaded from flash in [expr {[ms] - $t0}] ms"
+    return 1
+}